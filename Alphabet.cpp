@@ -0,0 +1,303 @@
+#include "Alphabet.hpp"
+#include "BlockKernel.hpp"
+
+#include <cctype>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HILL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	//symbol 255 marks a character outside the alphabet
+	const uint8_t BAD = 255;
+
+	struct Tables
+	{
+		uint8_t sym[256]; //with BAD for characters outside the alphabet
+		uint8_t zero[256]; //with 0 for characters outside the alphabet, like l2num
+		char let[29];
+
+		Tables()
+		{
+			for (int c = 0; c < 256; ++c)
+			{
+				if (isalpha(c))
+				{
+					sym[c] = static_cast<uint8_t>(toupper(c) - 'A');
+				}
+				else if (c == '.')
+				{
+					sym[c] = 26;
+				}
+				else if (c == '?')
+				{
+					sym[c] = 27;
+				}
+				else if (c == ' ')
+				{
+					sym[c] = 28;
+				}
+				else
+				{
+					sym[c] = BAD;
+				}
+				zero[c] = (sym[c] == BAD) ? 0 : sym[c];
+			}
+			for (int s = 0; s < 26; ++s)
+			{
+				let[s] = static_cast<char>('A' + s);
+			}
+			let[26] = '.';
+			let[27] = '?';
+			let[28] = ' ';
+		}
+	};
+
+	const Tables& tables()
+	{
+		static const Tables t;
+		return t;
+	}
+
+	//scalar ingest of [first, length); returns length or the first rejected index
+	size_t ingest_scalar(const unsigned char* in, size_t first, size_t length, uint8_t* out, Alphabet::Policy policy)
+	{
+		const Tables& t = tables();
+		if (policy == Alphabet::ZERO)
+		{
+			for (size_t i = first; i < length; ++i)
+			{
+				out[i] = t.zero[in[i]];
+			}
+			return length;
+		}
+		for (size_t i = first; i < length; ++i)
+		{
+			uint8_t s = t.sym[in[i]];
+			if (s == BAD)
+			{
+				return i;
+			}
+			out[i] = s;
+		}
+		return length;
+	}
+
+#ifdef HILL_X86
+	/*
+	 * Ingest, per byte c:
+	 *   letters: (c | 0x20) - 'a' is in [0,25] exactly for ASCII letters of either case, and is the symbol;
+	 *   '.', '?', ' ' (0x2E, 0x3F, 0x20): a shuffle on the low nibble picks the symbol from a 16-entry row for the
+	 *   high nibble 2 or 3, with BAD in every other slot;
+	 *   everything else is BAD.
+	 * Egress: s + 'A' for letters, a shuffle on s - 26 for the three punctuation symbols.
+	 * The 512-bit tables are broadcast with the zero-masking form, which unlike the plain one starts from a defined vector.
+	 */
+	__attribute__((target("sse4.2"))) size_t ingest_sse(const unsigned char* in, size_t length, uint8_t* out, Alphabet::Policy policy)
+	{
+		const __m128i row2 = _mm_setr_epi8(28, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1);
+		const __m128i row3 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 27);
+		const __m128i nib = _mm_set1_epi8(0x0F);
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			__m128i t = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+			__m128i letter = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t);
+			__m128i lo = _mm_and_si128(c, nib);
+			__m128i hi = _mm_and_si128(_mm_srli_epi16(c, 4), nib);
+			__m128i punct = _mm_set1_epi8(-1);
+			punct = _mm_blendv_epi8(punct, _mm_shuffle_epi8(row2, lo), _mm_cmpeq_epi8(hi, _mm_set1_epi8(2)));
+			punct = _mm_blendv_epi8(punct, _mm_shuffle_epi8(row3, lo), _mm_cmpeq_epi8(hi, _mm_set1_epi8(3)));
+			__m128i s = _mm_blendv_epi8(punct, t, letter);
+			__m128i bad = _mm_cmpeq_epi8(s, _mm_set1_epi8(-1));
+			if (policy == Alphabet::REJECT && _mm_movemask_epi8(bad))
+			{
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_andnot_si128(bad, s));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx2"))) size_t ingest_avx2(const unsigned char* in, size_t length, uint8_t* out, Alphabet::Policy policy)
+	{
+		const __m256i row2 = _mm256_setr_epi8(28, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1,
+			28, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1);
+		const __m256i row3 = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 27,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 27);
+		const __m256i nib = _mm256_set1_epi8(0x0F);
+		size_t i = 0;
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+			__m256i t = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+			__m256i letter = _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(25)), t);
+			__m256i lo = _mm256_and_si256(c, nib);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(c, 4), nib);
+			__m256i punct = _mm256_set1_epi8(-1);
+			punct = _mm256_blendv_epi8(punct, _mm256_shuffle_epi8(row2, lo), _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(2)));
+			punct = _mm256_blendv_epi8(punct, _mm256_shuffle_epi8(row3, lo), _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(3)));
+			__m256i s = _mm256_blendv_epi8(punct, t, letter);
+			__m256i bad = _mm256_cmpeq_epi8(s, _mm256_set1_epi8(-1));
+			if (policy == Alphabet::REJECT && _mm256_movemask_epi8(bad))
+			{
+				break;
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_andnot_si256(bad, s));
+		}
+		return i;
+	}
+
+	__attribute__((target("avx512f,avx512bw"))) size_t ingest_avx512(const unsigned char* in, size_t length, uint8_t* out, Alphabet::Policy policy)
+	{
+		const __m512i row2 = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_setr_epi8(28, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1));
+		const __m512i row3 = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 27));
+		const __m512i nib = _mm512_set1_epi8(0x0F);
+		size_t i = 0;
+		for (; i + 64 <= length; i += 64)
+		{
+			__m512i c = _mm512_loadu_si512(in + i);
+			__m512i t = _mm512_sub_epi8(_mm512_or_si512(c, _mm512_set1_epi8(0x20)), _mm512_set1_epi8('a'));
+			__mmask64 letter = _mm512_cmple_epu8_mask(t, _mm512_set1_epi8(25));
+			__m512i lo = _mm512_and_si512(c, nib);
+			__m512i hi = _mm512_and_si512(_mm512_srli_epi16(c, 4), nib);
+			__m512i s = _mm512_set1_epi8(-1);
+			s = _mm512_mask_shuffle_epi8(s, _mm512_cmpeq_epi8_mask(hi, _mm512_set1_epi8(2)), row2, lo);
+			s = _mm512_mask_shuffle_epi8(s, _mm512_cmpeq_epi8_mask(hi, _mm512_set1_epi8(3)), row3, lo);
+			s = _mm512_mask_mov_epi8(s, letter, t);
+			__mmask64 bad = _mm512_cmpeq_epi8_mask(s, _mm512_set1_epi8(-1));
+			if (policy == Alphabet::REJECT && bad)
+			{
+				break;
+			}
+			_mm512_storeu_si512(out + i, _mm512_maskz_mov_epi8(~bad, s));
+		}
+		return i;
+	}
+
+	__attribute__((target("sse4.2"))) size_t egress_sse(const uint8_t* in, size_t length, char* out)
+	{
+		const __m128i punct = _mm_setr_epi8('.', '?', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			__m128i isP = _mm_cmpeq_epi8(_mm_max_epu8(s, _mm_set1_epi8(26)), s);
+			__m128i p = _mm_shuffle_epi8(punct, _mm_sub_epi8(s, _mm_set1_epi8(26)));
+			__m128i c = _mm_blendv_epi8(_mm_add_epi8(s, _mm_set1_epi8('A')), p, isP);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), c);
+		}
+		return i;
+	}
+
+	__attribute__((target("avx2"))) size_t egress_avx2(const uint8_t* in, size_t length, char* out)
+	{
+		const __m256i punct = _mm256_setr_epi8('.', '?', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			'.', '?', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		size_t i = 0;
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+			__m256i isP = _mm256_cmpeq_epi8(_mm256_max_epu8(s, _mm256_set1_epi8(26)), s);
+			__m256i p = _mm256_shuffle_epi8(punct, _mm256_sub_epi8(s, _mm256_set1_epi8(26)));
+			__m256i c = _mm256_blendv_epi8(_mm256_add_epi8(s, _mm256_set1_epi8('A')), p, isP);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), c);
+		}
+		return i;
+	}
+
+	__attribute__((target("avx512f,avx512bw"))) size_t egress_avx512(const uint8_t* in, size_t length, char* out)
+	{
+		const __m512i punct = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_setr_epi8('.', '?', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+		size_t i = 0;
+		for (; i + 64 <= length; i += 64)
+		{
+			__m512i s = _mm512_loadu_si512(in + i);
+			__mmask64 isP = _mm512_cmpge_epu8_mask(s, _mm512_set1_epi8(26));
+			__m512i c = _mm512_add_epi8(s, _mm512_set1_epi8('A'));
+			c = _mm512_mask_shuffle_epi8(c, isP, punct, _mm512_sub_epi8(s, _mm512_set1_epi8(26)));
+			_mm512_storeu_si512(out + i, c);
+		}
+		return i;
+	}
+#endif
+}
+
+uint8_t Alphabet::symbol(char c)
+{
+	return tables().zero[static_cast<unsigned char>(c)];
+}
+
+bool Alphabet::contains(char c)
+{
+	return tables().sym[static_cast<unsigned char>(c)] != BAD;
+}
+
+char Alphabet::letter(uint8_t s)
+{
+	return tables().let[s];
+}
+
+const uint8_t* Alphabet::symbols()
+{
+	return tables().zero;
+}
+
+const char* Alphabet::letters()
+{
+	return tables().let;
+}
+
+size_t Alphabet::ingest(const char* in, size_t length, uint8_t* out, Policy policy)
+{
+	const unsigned char* src = reinterpret_cast<const unsigned char*>(in);
+	size_t done = 0;
+#ifdef HILL_X86
+	//a vector kernel stops early either at the tail or at a step with a rejected byte; the scalar loop settles both,
+	//converting the good bytes of that step so out is complete up to the rejected one
+	switch (BlockKernel::detect())
+	{
+	case BlockKernel::AVX512:
+		done = ingest_avx512(src, length, out, policy);
+		break;
+	case BlockKernel::AVX2:
+		done = ingest_avx2(src, length, out, policy);
+		break;
+	case BlockKernel::SSE42:
+		done = ingest_sse(src, length, out, policy);
+		break;
+	default:
+		break;
+	}
+#endif
+	return ingest_scalar(src, done, length, out, policy);
+}
+
+void Alphabet::egress(const uint8_t* in, size_t length, char* out)
+{
+	size_t done = 0;
+#ifdef HILL_X86
+	switch (BlockKernel::detect())
+	{
+	case BlockKernel::AVX512:
+		done = egress_avx512(in, length, out);
+		break;
+	case BlockKernel::AVX2:
+		done = egress_avx2(in, length, out);
+		break;
+	case BlockKernel::SSE42:
+		done = egress_sse(in, length, out);
+		break;
+	default:
+		break;
+	}
+#endif
+	const char* let = tables().let;
+	for (size_t i = done; i < length; ++i)
+	{
+		out[i] = let[in[i]];
+	}
+}
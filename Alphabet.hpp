@@ -0,0 +1,74 @@
+#ifndef _ALPHABET_HPP_
+#define _ALPHABET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The 29 character alphabet shared by every encryption path: 'A'..'Z' are 0..25 and '.', '?', ' ' are 26, 27, 28.
+ * Lowercase letters fold to their uppercase symbols.  Bulk conversion (ingest/egress) classifies 16, 32 or 64 bytes
+ * per step with shuffle-based lookups, using the same instruction set level as BlockKernel::detect().
+ */ 
+class Alphabet
+{
+public:
+  //what ingest does with a byte outside the alphabet
+  enum Policy
+  {
+    ZERO, //pass it on as symbol 0 ('A'), which is what l2num has always done
+    REJECT //stop and report its position, e.g. through Hill::encrypt(P, policy, rejected)
+  };
+
+  /**
+   * Maps a character to its symbol like Hill::l2num: letters (either case) to 0..25, '.', '?', ' ' to 26..28, anything else to 0.
+   * @param c - the character to map.
+   * @return the symbol in [0,29).
+   */ 
+  static uint8_t symbol( char c );
+
+  /**
+   * Tells whether a character belongs to the alphabet, i.e. can appear in a ciphertext; separators must not.
+   * @param c - the character to test.
+   * @return true for letters (either case), '.', '?' and ' ', false for anything else.
+   */ 
+  static bool contains( char c );
+
+  /**
+   * Maps a symbol back to its character exactly like Hill::n2let.
+   * @param s - a symbol in [0,29).
+   * @return the character for s.
+   */ 
+  static char letter( uint8_t s );
+
+  /**
+   * Returns the whole character-to-symbol table so hot loops can index it directly.
+   * @return 256 symbols, indexed by the character as unsigned char.
+   */ 
+  static const uint8_t * symbols();
+
+  /**
+   * Returns the whole symbol-to-character table so hot loops can index it directly.
+   * @return 29 characters, indexed by symbol.
+   */ 
+  static const char * letters();
+
+  /**
+   * Converts characters to symbols in bulk: validation, case folding and mapping in one vectorized pass.
+   * @param in - the characters to convert.
+   * @param length - number of characters.
+   * @param out - receives length symbols; may be the same buffer as in.
+   * @param policy - what to do with characters outside the alphabet.
+   * @return length if every character was converted, otherwise (REJECT only) the index of the first rejected character;
+   *         out then holds the symbols of every character before it.
+   */ 
+  static size_t ingest( const char *in, size_t length, uint8_t *out, Policy policy = ZERO );
+
+  /**
+   * Converts symbols back to characters in bulk.
+   * @param in - symbols in [0,29).
+   * @param length - number of symbols.
+   * @param out - receives length characters; may be the same buffer as in.
+   */ 
+  static void egress( const uint8_t *in, size_t length, char *out );
+};
+#endif
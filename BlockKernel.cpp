@@ -0,0 +1,452 @@
+#include "BlockKernel.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HILL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	//block-major symbols (symbol i of block b at sym[b*N + i]) to TILE-strided planes and back; N is a template
+	//parameter for the common key sizes so the compiler can turn the strided accesses into vector shuffles
+	template <unsigned int N>
+	void planes_in(const uint8_t* sym, uint8_t* tile, size_t count)
+	{
+		for (size_t b = 0; b < count; ++b)
+		{
+			for (unsigned int i = 0; i < N; ++i)
+			{
+				tile[i * BlockKernel::TILE + b] = sym[b * N + i];
+			}
+		}
+	}
+
+	template <unsigned int N>
+	void planes_out(const uint8_t* tile, uint8_t* sym, size_t count)
+	{
+		for (size_t b = 0; b < count; ++b)
+		{
+			for (unsigned int i = 0; i < N; ++i)
+			{
+				sym[b * N + i] = tile[i * BlockKernel::TILE + b];
+			}
+		}
+	}
+
+	void planes_in(unsigned int n, const uint8_t* sym, uint8_t* tile, size_t count)
+	{
+		switch (n)
+		{
+		case 2: planes_in<2>(sym, tile, count); return;
+		case 3: planes_in<3>(sym, tile, count); return;
+		case 4: planes_in<4>(sym, tile, count); return;
+		case 5: planes_in<5>(sym, tile, count); return;
+		case 6: planes_in<6>(sym, tile, count); return;
+		case 7: planes_in<7>(sym, tile, count); return;
+		case 8: planes_in<8>(sym, tile, count); return;
+		}
+		//plane-at-a-time so the inner loop runs over the (long) block index rather than the key size
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			for (size_t b = 0; b < count; ++b)
+			{
+				tile[i * BlockKernel::TILE + b] = sym[b * n + i];
+			}
+		}
+	}
+
+	//input stage of the fused loop: ingest characters or copy ready-made symbols; returns count or a rejected index
+	size_t load(const char* text, const uint8_t* symbols, size_t pos, size_t count, uint8_t* sym, Alphabet::Policy policy)
+	{
+		if (text)
+		{
+			return Alphabet::ingest(text + pos, count, sym, policy);
+		}
+		std::copy(symbols + pos, symbols + pos + count, sym);
+		return count;
+	}
+
+	//output stage of the fused loop: egress to characters or copy the symbols out
+	void store(const uint8_t* sym, size_t pos, size_t count, char* textOut, uint8_t* symbolsOut)
+	{
+		if (textOut)
+		{
+			Alphabet::egress(sym, count, textOut + pos);
+		}
+		else
+		{
+			std::copy(sym, sym + count, symbolsOut + pos);
+		}
+	}
+
+	void planes_out(unsigned int n, const uint8_t* tile, uint8_t* sym, size_t count)
+	{
+		switch (n)
+		{
+		case 2: planes_out<2>(tile, sym, count); return;
+		case 3: planes_out<3>(tile, sym, count); return;
+		case 4: planes_out<4>(tile, sym, count); return;
+		case 5: planes_out<5>(tile, sym, count); return;
+		case 6: planes_out<6>(tile, sym, count); return;
+		case 7: planes_out<7>(tile, sym, count); return;
+		case 8: planes_out<8>(tile, sym, count); return;
+		}
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			for (size_t b = 0; b < count; ++b)
+			{
+				sym[b * n + i] = tile[i * BlockKernel::TILE + b];
+			}
+		}
+	}
+}
+
+#ifdef HILL_X86
+namespace
+{
+	BlockKernel::Isa probe()
+	{
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512bw"))
+		{
+			return BlockKernel::AVX512;
+		}
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return BlockKernel::AVX2;
+		}
+		if (__builtin_cpu_supports("sse4.2"))
+		{
+			return BlockKernel::SSE42;
+		}
+		return BlockKernel::SCALAR;
+	}
+
+	//x mod 29 for 16-bit lanes: q = floor(x*2259 / 2^16) is x/29 or one less, so one conditional subtract finishes
+	__attribute__((target("sse4.2"))) inline __m128i mod29_sse(__m128i x)
+	{
+		__m128i q = _mm_mulhi_epu16(x, _mm_set1_epi16(2259));
+		__m128i r = _mm_sub_epi16(x, _mm_mullo_epi16(q, _mm_set1_epi16(29)));
+		return _mm_min_epu16(r, _mm_sub_epi16(r, _mm_set1_epi16(29)));
+	}
+
+	__attribute__((target("avx2"))) inline __m256i mod29_avx2(__m256i x)
+	{
+		__m256i q = _mm256_mulhi_epu16(x, _mm256_set1_epi16(2259));
+		__m256i r = _mm256_sub_epi16(x, _mm256_mullo_epi16(q, _mm256_set1_epi16(29)));
+		return _mm256_min_epu16(r, _mm256_sub_epi16(r, _mm256_set1_epi16(29)));
+	}
+
+	__attribute__((target("avx512f,avx512bw"))) inline __m512i mod29_avx512(__m512i x)
+	{
+		__m512i q = _mm512_mulhi_epu16(x, _mm512_set1_epi16(2259));
+		__m512i r = _mm512_sub_epi16(x, _mm512_mullo_epi16(q, _mm512_set1_epi16(29)));
+		return _mm512_min_epu16(r, _mm512_sub_epi16(r, _mm512_set1_epi16(29)));
+	}
+
+	//16 blocks per step: widen each plane to two 8-lane halves, multiply-accumulate, reduce and pack back to bytes
+	__attribute__((target("sse4.2"))) size_t kernel_sse(const uint16_t* K, unsigned int n, const uint8_t* in, uint8_t* out, size_t blocks, size_t stride)
+	{
+		size_t b = 0;
+		__m128i lo[BlockKernel::MAX_SIMD_SIZE];
+		__m128i hi[BlockKernel::MAX_SIMD_SIZE];
+		for (; b + 16 <= blocks; b += 16)
+		{
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * stride + b));
+				lo[i] = _mm_cvtepu8_epi16(p);
+				hi[i] = _mm_cvtepu8_epi16(_mm_srli_si128(p, 8));
+			}
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				__m128i a = _mm_setzero_si128();
+				__m128i c = _mm_setzero_si128();
+				for (unsigned int i = 0; i < n; ++i)
+				{
+					__m128i e = _mm_set1_epi16(K[k * n + i]);
+					a = _mm_add_epi16(a, _mm_mullo_epi16(e, lo[i]));
+					c = _mm_add_epi16(c, _mm_mullo_epi16(e, hi[i]));
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + k * stride + b), _mm_packus_epi16(mod29_sse(a), mod29_sse(c)));
+			}
+		}
+		return b;
+	}
+
+	//32 blocks per step
+	__attribute__((target("avx2"))) size_t kernel_avx2(const uint16_t* K, unsigned int n, const uint8_t* in, uint8_t* out, size_t blocks, size_t stride)
+	{
+		size_t b = 0;
+		__m256i lo[BlockKernel::MAX_SIMD_SIZE];
+		__m256i hi[BlockKernel::MAX_SIMD_SIZE];
+		for (; b + 32 <= blocks; b += 32)
+		{
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				lo[i] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * stride + b)));
+				hi[i] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * stride + b + 16)));
+			}
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				__m256i a = _mm256_setzero_si256();
+				__m256i c = _mm256_setzero_si256();
+				for (unsigned int i = 0; i < n; ++i)
+				{
+					__m256i e = _mm256_set1_epi16(K[k * n + i]);
+					a = _mm256_add_epi16(a, _mm256_mullo_epi16(e, lo[i]));
+					c = _mm256_add_epi16(c, _mm256_mullo_epi16(e, hi[i]));
+				}
+				//packus works per 128-bit lane, so restore block order afterwards
+				__m256i r = _mm256_packus_epi16(mod29_avx2(a), mod29_avx2(c));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * stride + b), _mm256_permute4x64_epi64(r, 0xD8));
+			}
+		}
+		return b;
+	}
+
+	//64 blocks per step
+	__attribute__((target("avx512f,avx512bw"))) size_t kernel_avx512(const uint16_t* K, unsigned int n, const uint8_t* in, uint8_t* out, size_t blocks, size_t stride)
+	{
+		const __mmask32 ALL = 0xFFFFFFFF;
+		size_t b = 0;
+		__m512i lo[BlockKernel::MAX_SIMD_SIZE];
+		__m512i hi[BlockKernel::MAX_SIMD_SIZE];
+		for (; b + 64 <= blocks; b += 64)
+		{
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				lo[i] = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * stride + b)));
+				hi[i] = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * stride + b + 32)));
+			}
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				__m512i a = _mm512_setzero_si512();
+				__m512i c = _mm512_setzero_si512();
+				for (unsigned int i = 0; i < n; ++i)
+				{
+					__m512i e = _mm512_set1_epi16(K[k * n + i]);
+					a = _mm512_add_epi16(a, _mm512_mullo_epi16(e, lo[i]));
+					c = _mm512_add_epi16(c, _mm512_mullo_epi16(e, hi[i]));
+				}
+				//the zero-masking form: the plain one hands an undefined vector to the masked builtin, which -Wall reports
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * stride + b), _mm512_maskz_cvtepi16_epi8(ALL, mod29_avx512(a)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * stride + b + 32), _mm512_maskz_cvtepi16_epi8(ALL, mod29_avx512(c)));
+			}
+		}
+		return b;
+	}
+}
+#endif
+
+BlockKernel::BlockKernel()
+{
+	this->n = 0;
+	this->level = SCALAR;
+}
+
+BlockKernel::BlockKernel(const Matrix& K, Isa isa)
+{
+	this->n = 0;
+	this->level = SCALAR;
+	if (K.size(1) == K.size(2) && K.size(1) >= 2)
+	{
+		this->n = K.size(1);
+		this->K.resize(this->n * this->n);
+		for (unsigned int k = 0; k < this->n; ++k)
+		{
+			for (unsigned int i = 0; i < this->n; ++i)
+			{
+				int e = K.get(k, i) % 29;
+				this->K[k * this->n + i] = static_cast<uint16_t>(e < 0 ? e + 29 : e);
+			}
+		}
+		this->T = ColumnTable(K);
+
+		Isa host = detect();
+		this->level = (isa < host) ? isa : host;
+		if (this->n > MAX_SIMD_SIZE)
+		{
+			this->level = SCALAR;
+		}
+	}
+}
+
+unsigned int BlockKernel::size() const
+{
+	return this->n;
+}
+
+BlockKernel::Isa BlockKernel::isa() const
+{
+	return this->level;
+}
+
+void BlockKernel::transform(const uint8_t* in, uint8_t* out, size_t blocks, size_t stride) const
+{
+	if (this->n == 0)
+	{
+		return;
+	}
+	size_t done = 0;
+#ifdef HILL_X86
+	//the vector kernels read all n planes of a step before writing any, so in == out is safe
+	if (this->level == AVX512)
+	{
+		done = kernel_avx512(&this->K[0], this->n, in, out, blocks, stride);
+	}
+	else if (this->level == AVX2)
+	{
+		done = kernel_avx2(&this->K[0], this->n, in, out, blocks, stride);
+	}
+	else if (this->level == SSE42)
+	{
+		done = kernel_sse(&this->K[0], this->n, in, out, blocks, stride);
+	}
+#endif
+	this->scalar(in, out, done, blocks, stride);
+}
+
+size_t BlockKernel::text(const char* in, size_t length, char* out, Alphabet::Policy policy) const
+{
+	return this->fused(in, nullptr, length, out, nullptr, policy);
+}
+
+void BlockKernel::textToSymbols(const char* in, size_t length, uint8_t* out) const
+{
+	this->fused(in, nullptr, length, nullptr, out, Alphabet::ZERO);
+}
+
+void BlockKernel::symbolsToText(const uint8_t* in, size_t length, char* out) const
+{
+	this->fused(nullptr, in, length, out, nullptr, Alphabet::ZERO);
+}
+
+size_t BlockKernel::padded(size_t length) const
+{
+	if (this->n == 0)
+	{
+		return 0;
+	}
+	return (length + this->n - 1) / this->n * this->n;
+}
+
+BlockKernel::Isa BlockKernel::detect()
+{
+#ifdef HILL_X86
+	static const Isa host = probe();
+	return host;
+#else
+	return SCALAR;
+#endif
+}
+
+const char* BlockKernel::name(Isa isa)
+{
+	switch (isa)
+	{
+	case SSE42:
+		return "sse4.2";
+	case AVX2:
+		return "avx2";
+	case AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+//Private section
+//blocks [first, last) one at a time; large keys use the column tables, small ones a direct dot product
+void BlockKernel::scalar(const uint8_t* in, uint8_t* out, size_t first, size_t last, size_t stride) const
+{
+	if (first >= last)
+	{
+		return;
+	}
+	if (this->T.size())
+	{
+		this->T.apply(in + first, out + first, last - first, stride);
+		return;
+	}
+	uint8_t p[MAX_SIMD_SIZE];
+	std::vector<uint8_t> big(this->n > MAX_SIMD_SIZE ? this->n : 0);
+	uint8_t* col = big.empty() ? p : &big[0];
+	for (size_t b = first; b < last; ++b)
+	{
+		for (unsigned int i = 0; i < this->n; ++i)
+		{
+			col[i] = in[i * stride + b];
+		}
+		for (unsigned int k = 0; k < this->n; ++k)
+		{
+			uint32_t acc = 0;
+			for (unsigned int i = 0; i < this->n; ++i)
+			{
+				acc += this->K[k * this->n + i] * col[i];
+			}
+			out[k * stride + b] = static_cast<uint8_t>(acc % 29);
+		}
+	}
+}
+
+//the fused tile loop behind text, textToSymbols and symbolsToText: exactly one of text/symbols is the input and
+//exactly one of textOut/symbolsOut the output, so only the ingest and egress stages differ; a rejected character
+//stops the loop before its tile is written
+size_t BlockKernel::fused(const char* text, const uint8_t* symbols, size_t length, char* textOut, uint8_t* symbolsOut,
+	Alphabet::Policy policy) const
+{
+	if (this->n == 0 || length == 0)
+	{
+		return length;
+	}
+	size_t blocks = (length + this->n - 1) / this->n;
+
+	if (this->n > MAX_SIMD_SIZE)
+	{
+		//huge keys: one block at a time through a single column buffer
+		std::vector<uint8_t> col(this->n);
+		for (size_t b = 0; b < blocks; ++b)
+		{
+			size_t pos = b * this->n;
+			size_t have = (length - pos < this->n) ? length - pos : this->n;
+			size_t got = load(text, symbols, pos, have, &col[0], policy);
+			if (got < have)
+			{
+				return pos + got;
+			}
+			std::fill(col.begin() + have, col.end(), 26);
+			this->scalar(&col[0], &col[0], 0, 1, 1);
+			store(&col[0], pos, this->n, textOut, symbolsOut);
+		}
+		return length;
+	}
+
+	//both tiles live on the stack and stay in L1: characters are ingested into sym (block-major), transposed into
+	//the interleaved tile, transformed, transposed back and egressed, so nothing else touches memory.
+	//n is copied to a local because every byte store below may alias this->n as far as the compiler knows
+	const unsigned int n = this->n;
+	uint8_t sym[MAX_SIMD_SIZE * TILE];
+	uint8_t tile[MAX_SIMD_SIZE * TILE];
+	for (size_t base = 0; base < blocks; base += TILE)
+	{
+		size_t count = (blocks - base < TILE) ? blocks - base : TILE;
+		size_t avail = length - base * n; //characters left, less than count*n only in the last tile
+		size_t have = (avail < count * n) ? avail : count * n;
+		size_t got = load(text, symbols, base * n, have, sym, policy);
+		if (got < have)
+		{
+			return base * n + got;
+		}
+		std::fill(sym + have, sym + count * n, 26);
+
+		planes_in(n, sym, tile, count);
+		this->transform(tile, tile, count, TILE);
+		planes_out(n, tile, sym, count);
+
+		store(sym, base * n, count * n, textOut, symbolsOut);
+	}
+	return length;
+}
@@ -0,0 +1,122 @@
+#ifndef _BLOCKKERNEL_HPP_
+#define _BLOCKKERNEL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Alphabet.hpp"
+#include "ColumnTable.hpp"
+
+/**
+ * A prepared n-by-n Hill key that applies the block transform C = K*P mod 29 to many blocks at once.
+ * Blocks are kept in an interleaved layout: symbol i of block b lives at in[i*stride + b], so one vector
+ * instruction touches 16 (SSE4.2), 32 (AVX2) or 64 (AVX-512) blocks.  The widest kernel the host supports
+ * is picked at runtime through CPUID, so one binary runs everywhere.
+ */ 
+class BlockKernel
+{
+public:
+  //instruction set levels, in increasing order of width
+  enum Isa { SCALAR = 0, SSE42 = 1, AVX2 = 2, AVX512 = 3 };
+
+  //largest key the 16-bit vector accumulators can hold (64*28*28 < 2^16); bigger keys run scalar
+  static const unsigned int MAX_SIMD_SIZE = 64;
+
+  //blocks per tile in the fused text kernel; two AVX-512 steps
+  static const unsigned int TILE = 128;
+
+  /**
+   * Default constructor. It creates an empty kernel (size() == 0) that cannot be applied.
+   */ 
+  BlockKernel();
+
+  /**
+   * Parameterized constructor.  Prepares K for the block transform; if K is not square with n >= 2 then create an empty kernel.
+   * @param K - the key matrix (encryption or decryption); elements are reduced mod 29.
+   * @param isa - the widest instruction set to use; it is clamped to what the host supports.
+   */ 
+  BlockKernel(const Matrix &K, Isa isa = AVX512);
+
+  /**
+   * Returns the key size the kernel was prepared for.
+   * @return n for an n-by-n key, 0 if the kernel is empty.
+   */ 
+  unsigned int size() const;
+
+  /**
+   * Returns the instruction set the kernel dispatches to.
+   * @return the selected Isa.
+   */ 
+  Isa isa() const;
+
+  /**
+   * Applies the transform to interleaved blocks; in and out may be the same buffer.
+   * @param in - n planes of symbols in [0,29), symbol i of block b at in[i*stride + b].
+   * @param out - n planes receiving the transformed symbols, same layout as in.
+   * @param blocks - number of blocks in each plane.
+   * @param stride - distance between planes, at least blocks.
+   */ 
+  void transform( const uint8_t *in, uint8_t *out, size_t blocks, size_t stride ) const;
+
+  /**
+   * Fused text-to-text transform: reads n characters per block, maps them to symbols, multiplies, reduces and writes n
+   * characters, one small tile at a time, without building Matrix objects or heap buffers.  The last block is padded
+   * with '.' like Hill::l2num, so the result equals n2let(K*l2num(text)).
+   * @param in - the text to transform.
+   * @param length - number of characters in in.
+   * @param out - receives padded(length) characters; it may be the same buffer as in, but must not otherwise overlap it.
+   * @param policy - what to do with characters outside the alphabet, see Alphabet::ingest.
+   * @return length, or (Alphabet::REJECT only) the index of the first character outside the alphabet, and out is then
+   *         incomplete.
+   */ 
+  size_t text( const char *in, size_t length, char *out, Alphabet::Policy policy = Alphabet::ZERO ) const;
+
+  /**
+   * Like text, but writes the transformed symbols (0..28) instead of characters.
+   * @param in - the text to transform.
+   * @param length - number of characters in in.
+   * @param out - receives padded(length) symbols.
+   */ 
+  void textToSymbols( const char *in, size_t length, uint8_t *out ) const;
+
+  /**
+   * Like text, but reads symbols (0..28) instead of characters.
+   * @param in - the symbols to transform.
+   * @param length - number of symbols in in; a partial last block is padded with 26 ('.').
+   * @param out - receives padded(length) characters.
+   */ 
+  void symbolsToText( const uint8_t *in, size_t length, char *out ) const;
+
+  /**
+   * Returns the length of the transformed text for a given input length.
+   * @param length - number of input characters.
+   * @return length rounded up to a whole number of blocks, 0 if the kernel is empty.
+   */ 
+  size_t padded( size_t length ) const;
+
+  /**
+   * Returns the widest instruction set supported by this host.
+   * @return the detected Isa.
+   */ 
+  static Isa detect();
+
+  /**
+   * Returns a printable name for an instruction set level.
+   * @param isa - the level to name.
+   * @return "scalar", "sse4.2", "avx2" or "avx512".
+   */ 
+  static const char * name( Isa isa );
+
+private:
+  unsigned int n; //key size, 0 if empty
+  Isa level; //kernel selected for this key
+  std::vector<uint16_t> K; //key reduced mod 29, row-major: K[k*n + i] = K(k,i)
+  ColumnTable T; //scalar path for 4-by-4 to 16-by-16 keys
+
+  void scalar(const uint8_t *in, uint8_t *out, size_t first, size_t last, size_t stride) const;
+  size_t fused(const char *text, const uint8_t *symbols, size_t length, char *textOut, uint8_t *symbolsOut,
+               Alphabet::Policy policy) const;
+};
+#endif
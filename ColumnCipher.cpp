@@ -0,0 +1,456 @@
+#include "ColumnCipher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include <immintrin.h>
+
+namespace
+{
+	//one gathered field: where its transform goes in out, and its padded length
+	struct Span
+	{
+		size_t at;
+		size_t length;
+	};
+
+	//bit i set if p[i] is the delimiter, '\n' or the quote character, for 64 bytes
+	uint64_t structural_sse(const char* p, char delimiter, char quote)
+	{
+		const __m128i d = _mm_set1_epi8(delimiter);
+		const __m128i n = _mm_set1_epi8('\n');
+		const __m128i q = _mm_set1_epi8(quote);
+		uint64_t mask = 0;
+		for (unsigned int k = 0; k < 64; k += 16)
+		{
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k));
+			__m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, d), _mm_cmpeq_epi8(c, n)), _mm_cmpeq_epi8(c, q));
+			mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hit))) << k;
+		}
+		return mask;
+	}
+
+	__attribute__((target("avx2"))) uint64_t structural_avx2(const char* p, char delimiter, char quote)
+	{
+		const __m256i d = _mm256_set1_epi8(delimiter);
+		const __m256i n = _mm256_set1_epi8('\n');
+		const __m256i q = _mm256_set1_epi8(quote);
+		__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+		__m256i a = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lo, d), _mm256_cmpeq_epi8(lo, n)), _mm256_cmpeq_epi8(lo, q));
+		__m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(hi, d), _mm256_cmpeq_epi8(hi, n)), _mm256_cmpeq_epi8(hi, q));
+		return static_cast<uint32_t>(_mm256_movemask_epi8(a)) | (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(b))) << 32);
+	}
+
+	uint64_t structural_scalar(const char* p, size_t length, char delimiter, char quote)
+	{
+		uint64_t mask = 0;
+		for (size_t i = 0; i < length; ++i)
+		{
+			if (p[i] == delimiter || p[i] == '\n' || p[i] == quote)
+			{
+				mask |= uint64_t(1) << i;
+			}
+		}
+		return mask;
+	}
+
+	typedef uint64_t (*Structural)(const char*, char, char);
+
+	Structural structural()
+	{
+		static const Structural f = (BlockKernel::detect() >= BlockKernel::AVX2) ? structural_avx2 : structural_sse;
+		return f;
+	}
+
+	//copy the content of a field to dst: a leading quote opens it, "" is one quote, the next lone quote closes it
+	size_t unquote(const char* p, size_t length, char* dst)
+	{
+		if (length == 0 || p[0] != '"')
+		{
+			std::memcpy(dst, p, length);
+			return length;
+		}
+		char* d = dst;
+		size_t i = 1;
+		while (i < length)
+		{
+			const char* q = static_cast<const char*>(std::memchr(p + i, '"', length - i));
+			size_t j = q ? static_cast<size_t>(q - p) : length;
+			std::memcpy(d, p + i, j - i);
+			d += j - i;
+			if (!q)
+			{
+				return static_cast<size_t>(d - dst);
+			}
+			if (j + 1 < length && p[j + 1] == '"')
+			{
+				*d++ = '"';
+				i = j + 2;
+			}
+			else
+			{
+				i = j + 1;
+				break;
+			}
+		}
+		std::memcpy(d, p + i, length - i); //anything after the closing quote, for malformed input
+		return static_cast<size_t>(d - dst) + (length - i);
+	}
+
+	bool writeAll(int fd, const char* p, size_t size)
+	{
+		while (size > 0)
+		{
+			ssize_t put = ::write(fd, p, size);
+			if (put < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+			p += put;
+			size -= static_cast<size_t>(put);
+		}
+		return true;
+	}
+}
+
+const unsigned int ColumnCipher::MAX_COLUMNS;
+
+ColumnCipher::ColumnCipher(const BlockKernel& K, const std::vector<unsigned int>& columns, char delimiter, bool quotes, unsigned int threads)
+	: K(K), pool(threads)
+{
+	bool inRange = true;
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		if (columns[i] >= MAX_COLUMNS)
+		{
+			inRange = false;
+			continue;
+		}
+		if (columns[i] >= this->selected.size())
+		{
+			this->selected.resize(columns[i] + 1, false);
+		}
+		this->selected[columns[i]] = true;
+	}
+	this->delimiter = delimiter;
+	this->quotes = quotes;
+	this->usable = inRange && !Alphabet::contains(delimiter) && delimiter != '\n' && !(quotes && delimiter == '"');
+	this->total = 0;
+}
+
+size_t ColumnCipher::transform(const char* s, size_t size, bool last, std::string& out)
+{
+	if (this->K.size() == 0 || !this->usable)
+	{
+		return 0;
+	}
+	const size_t PIECE = 1 << 20;
+	size_t pieces = std::min<size_t>(size / PIECE, this->pool.size() * 4);
+	if (pieces <= 1 || this->pool.size() == 1)
+	{
+		return this->records(s, 0, size, last, out);
+	}
+
+	//pass 1: quotes per piece, so every piece knows whether it starts inside a quoted field
+	std::vector<size_t> bounds(pieces + 1);
+	for (size_t i = 0; i <= pieces; ++i)
+	{
+		bounds[i] = size / pieces * i;
+	}
+	bounds[pieces] = size;
+	std::vector<size_t> counts(pieces, 0);
+	if (this->quotes)
+	{
+		for (size_t i = 0; i < pieces; ++i)
+		{
+			this->pool.submit([s, &bounds, &counts, i]() { counts[i] = std::count(s + bounds[i], s + bounds[i + 1], '"'); });
+		}
+		this->pool.wait();
+	}
+
+	//pass 2: move every piece start forward to the next record boundary
+	std::vector<size_t> cuts(pieces + 1, 0);
+	cuts[pieces] = size;
+	size_t parity = 0;
+	for (size_t i = 1; i < pieces; ++i)
+	{
+		parity += counts[i - 1];
+		bool inside = (parity & 1) != 0;
+		this->pool.submit([this, s, size, &bounds, &cuts, i, inside]() { cuts[i] = this->recordStart(s, bounds[i], size, inside); });
+	}
+	this->pool.wait();
+	for (size_t i = 1; i < pieces; ++i)
+	{
+		cuts[i] = std::max(cuts[i], cuts[i - 1]);
+	}
+
+	//pass 3: transform the records of every piece, only the piece ending at size may hold an incomplete record
+	std::vector<std::string> outs(pieces);
+	std::vector<size_t> ends(pieces, 0);
+	for (size_t i = 0; i < pieces; ++i)
+	{
+		bool whole = last || cuts[i + 1] != size;
+		this->pool.submit([this, s, &cuts, &outs, &ends, i, whole]() { ends[i] = this->records(s, cuts[i], cuts[i + 1], whole, outs[i]); });
+	}
+	this->pool.wait();
+
+	size_t used = size;
+	size_t length = 0;
+	for (size_t i = 0; i < pieces; ++i)
+	{
+		length += outs[i].size();
+	}
+	out.reserve(out.size() + length);
+	for (size_t i = 0; i < pieces; ++i)
+	{
+		out += outs[i];
+		if (cuts[i + 1] == size)
+		{
+			used = ends[i];
+			break;
+		}
+	}
+	return used;
+}
+
+std::string ColumnCipher::transform(const std::string& s)
+{
+	std::string out;
+	this->transform(s.data(), s.size(), true, out);
+	return out;
+}
+
+bool ColumnCipher::run(int in, int out, size_t chunk)
+{
+	this->total = 0;
+	if (this->K.size() == 0 || !this->usable)
+	{
+		return false;
+	}
+	std::string buffer(chunk ? chunk : 1, '\0');
+	std::string result;
+	size_t have = 0;
+	bool eof = false;
+	while (!eof)
+	{
+		while (!eof && have < buffer.size())
+		{
+			ssize_t got = ::read(in, &buffer[have], buffer.size() - have);
+			if (got < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+			if (got == 0)
+			{
+				eof = true;
+			}
+			have += static_cast<size_t>(got);
+		}
+
+		result.clear();
+		size_t used = this->transform(buffer.data(), have, eof, result);
+		if (!writeAll(out, result.data(), result.size()))
+		{
+			return false;
+		}
+		this->total += used;
+		std::memmove(&buffer[0], &buffer[used], have - used);
+		have -= used;
+		if (have == buffer.size())
+		{
+			buffer.resize(buffer.size() * 2); //one record longer than the whole buffer
+		}
+	}
+	return true;
+}
+
+uint64_t ColumnCipher::consumed() const
+{
+	return this->total;
+}
+
+//Private section
+size_t ColumnCipher::records(const char* s, size_t begin, size_t end, bool whole, std::string& out) const
+{
+	const Structural scan = structural();
+	const char quote = this->quotes ? '"' : '\n'; //without quoting, look for newlines twice
+	const size_t columns = this->selected.size();
+	const size_t n = this->K.size();
+
+	//out and scratch are sized ahead and filled through positions, so a field costs two memcpy and no reallocation
+	size_t at = out.size(); //end of the result in out
+	out.resize(at + (end - begin) + 64);
+	//content of every chosen field, each padded to whole blocks; kept per thread so its pages stay mapped between calls
+	thread_local std::string scratch;
+	thread_local std::vector<Span> spans;
+	if (scratch.size() < (end - begin) / 2 + 64)
+	{
+		scratch.resize((end - begin) / 2 + 64);
+	}
+	size_t used = 0; //end of the content in scratch
+	spans.clear();
+
+	size_t field = 0;
+	size_t start = begin; //first byte of the current field
+	size_t copied = begin; //input before this is already in out
+	bool inside = false;
+	bool quoted = false;
+
+	//state after the last complete record, to drop an incomplete one
+	size_t done = begin;
+	size_t doneAt = at;
+	size_t doneCopied = begin;
+	size_t doneUsed = 0;
+	size_t doneSpans = 0;
+
+	auto finish = [&](size_t stop) {
+		if (field < columns && this->selected[field])
+		{
+			size_t raw = start - copied;
+			size_t length = stop - start;
+			if (at + raw + length + n > out.size())
+			{
+				out.resize(2 * out.size() + raw + length + n);
+			}
+			if (used + length + n > scratch.size())
+			{
+				scratch.resize(2 * scratch.size() + length + n);
+			}
+			std::memcpy(&out[at], s + copied, raw);
+			at += raw;
+			if (quoted)
+			{
+				length = unquote(s + start, length, &scratch[used]);
+			}
+			else
+			{
+				std::memcpy(&scratch[used], s + start, length);
+			}
+			size_t padded = (length + n - 1) / n * n;
+			std::memset(&scratch[used + length], '.', padded - length);
+			Span span = { at, padded };
+			spans.push_back(span);
+			at += padded;
+			used += padded;
+			copied = stop;
+		}
+		++field;
+		quoted = false;
+	};
+
+	for (size_t base = begin; base < end; base += 64)
+	{
+		uint64_t mask = (end - base >= 64) ? scan(s + base, this->delimiter, quote) : structural_scalar(s + base, end - base, this->delimiter, quote);
+		while (mask)
+		{
+			size_t i = base + static_cast<size_t>(__builtin_ctzll(mask));
+			mask &= mask - 1;
+			char c = s[i];
+			if (c == '"' && this->quotes)
+			{
+				inside = !inside;
+				quoted = true;
+			}
+			else if (inside)
+			{
+				continue;
+			}
+			else if (c == this->delimiter)
+			{
+				finish(i);
+				start = i + 1;
+			}
+			else
+			{
+				finish((i > start && s[i - 1] == '\r') ? i - 1 : i);
+				field = 0;
+				start = i + 1;
+				done = i + 1;
+				doneAt = at;
+				doneCopied = copied;
+				doneUsed = used;
+				doneSpans = spans.size();
+			}
+		}
+	}
+
+	if (whole)
+	{
+		if (start < end || field > 0)
+		{
+			finish(end);
+		}
+		done = end;
+	}
+	else
+	{
+		at = doneAt;
+		copied = doneCopied;
+		used = doneUsed;
+		spans.resize(doneSpans);
+	}
+	//the input between the last chosen field and the end is copied as is
+	if (at + (done - copied) > out.size())
+	{
+		out.resize(at + (done - copied));
+	}
+	std::memcpy(&out[at], s + copied, done - copied);
+	out.resize(at + (done - copied));
+
+	if (used)
+	{
+		this->K.text(scratch.data(), used, &scratch[0]);
+		size_t off = 0;
+		for (size_t i = 0; i < spans.size(); ++i)
+		{
+			std::memcpy(&out[spans[i].at], &scratch[off], spans[i].length);
+			off += spans[i].length;
+		}
+	}
+	if (scratch.size() > (16 << 20))
+	{
+		std::string().swap(scratch); //do not pin the buffer of one huge call
+		std::vector<Span>().swap(spans);
+	}
+	return done;
+}
+
+size_t ColumnCipher::recordStart(const char* s, size_t from, size_t size, bool inside) const
+{
+	size_t i = from;
+	while (i < size)
+	{
+		if (inside)
+		{
+			const char* q = static_cast<const char*>(std::memchr(s + i, '"', size - i));
+			if (!q)
+			{
+				return size;
+			}
+			inside = false;
+			i = static_cast<size_t>(q - s) + 1;
+			continue;
+		}
+		const char* nl = static_cast<const char*>(std::memchr(s + i, '\n', size - i));
+		size_t limit = nl ? static_cast<size_t>(nl - s) : size;
+		const char* q = this->quotes ? static_cast<const char*>(std::memchr(s + i, '"', limit - i)) : nullptr;
+		if (!q)
+		{
+			return nl ? limit + 1 : size;
+		}
+		inside = true;
+		i = static_cast<size_t>(q - s) + 1;
+	}
+	return size;
+}
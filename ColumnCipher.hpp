@@ -0,0 +1,93 @@
+#ifndef _COLUMNCIPHER_HPP_
+#define _COLUMNCIPHER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Encrypts (or decrypts) selected columns of CSV or TSV text and copies every other byte through unchanged.  Records
+ * end with '\n' (a '\r' before it stays out of the field); fields may be quoted with '"', where "" stands for one quote
+ * and delimiters and newlines do not count.  A chosen field is replaced by the transform of its unquoted content, padded
+ * to whole blocks like Hill::encrypt; the result only uses alphabet characters, so it never needs quotes.
+ *
+ * Field boundaries are found 64 bytes at a time with vector compares that turn delimiters, newlines and quotes into a
+ * bit mask.  The content of every chosen field in a piece is gathered into one buffer and transformed in a single
+ * BlockKernel::text call.  Large inputs are cut into pieces that run on a ThreadPool: a first pass counts the quotes of
+ * every piece, so each piece knows whether it starts inside a quoted field and can move its start to the next real
+ * record boundary.
+ */ 
+class ColumnCipher
+{
+public:
+  static const unsigned int MAX_COLUMNS = 1 << 16; //fields per record that can be chosen for transformation
+
+  /**
+   * Parameterized constructor.
+   * @param K - the prepared key to apply to the chosen fields; it must outlive the object.
+   * @param columns - indexes of the fields to transform, 0 for the first field of a record.  An index of MAX_COLUMNS
+   *                  or more leaves the object unusable.
+   * @param delimiter - the field separator, e.g. ',' or '\t'.  Ciphertext uses every character of the alphabet, so a
+   *                    delimiter in it (letters, '.', '?', ' '), '\n' or (with quotes) '"' leaves the object unusable:
+   *                    transform then consumes nothing and run() fails.
+   * @param quotes - true to honour '"' quoting (CSV), false to treat '"' as an ordinary character.
+   * @param threads - number of workers, 0 for one per hardware thread.
+   */ 
+  ColumnCipher(const BlockKernel &K, const std::vector<unsigned int> &columns, char delimiter = ',', bool quotes = true,
+               unsigned int threads = 0);
+
+  ColumnCipher(const ColumnCipher &) = delete;
+  ColumnCipher & operator=(const ColumnCipher &) = delete;
+
+  /**
+   * Transforms the complete records at the start of a buffer and appends the result to out.
+   * @param s - the text.
+   * @param size - number of characters in s.
+   * @param last - true if s ends the input, so a final record without '\n' is transformed too.
+   * @param out - receives the transformed records.
+   * @return the number of characters of s consumed: size if last, otherwise the end of the last complete record.
+   */ 
+  size_t transform( const char * s, size_t size, bool last, std::string & out );
+
+  /**
+   * Transforms a whole text.
+   * @param s - the text.
+   * @return the text with the chosen columns transformed, an empty string if the key is empty or the delimiter invalid.
+   */ 
+  std::string transform( const std::string & s );
+
+  /**
+   * Transforms everything read from a descriptor, until end of file, and writes it to another descriptor.
+   * @param in - descriptor to read the text from.
+   * @param out - descriptor to write the result to.
+   * @param chunk - bytes read before a batch of records is transformed; a longer record grows the batch.
+   * @return true if the whole input was transformed and written, false if the key is empty, the delimiter invalid or
+   *         I/O failed.
+   */ 
+  bool run( int in, int out, size_t chunk = 4 << 20 );
+
+  /**
+   * Returns the number of input bytes transformed by run() so far.
+   * @return the byte count.
+   */ 
+  uint64_t consumed() const;
+
+private:
+  const BlockKernel &K;
+  std::vector<bool> selected; //selected[i] is true if field i is transformed
+  char delimiter;
+  bool quotes;
+  bool usable; //false if the delimiter could appear inside a transformed field or a column index is out of range
+  ThreadPool pool;
+  uint64_t total;
+
+  //transform the records in [begin, end) into out; begin is a record start; returns the end of what was transformed
+  size_t records(const char *s, size_t begin, size_t end, bool whole, std::string &out) const;
+  //the start of the first record at or after from, given whether from is inside quotes
+  size_t recordStart(const char *s, size_t from, size_t size, bool inside) const;
+};
+#endif
@@ -0,0 +1,96 @@
+#include "ColumnTable.hpp"
+
+ColumnTable::ColumnTable()
+{
+	this->n = 0;
+}
+
+ColumnTable::ColumnTable(const Matrix& K)
+{
+	this->n = 0;
+	if (K.size(1) == K.size(2) && K.size(1) >= MIN_SIZE && K.size(1) <= MAX_SIZE)
+	{
+		this->n = K.size(1);
+		this->T.assign(this->n * 29 * WIDTH, 0);
+		for (unsigned int j = 0; j < this->n; ++j)
+		{
+			for (unsigned int k = 0; k < this->n; ++k)
+			{
+				int e = K.get(k, j) % 29;
+				if (e < 0)
+				{
+					e += 29;
+				}
+				//T_j[x] = T_j[x-1] + e, so the tables are built with additions only
+				uint16_t v = 0;
+				for (unsigned int x = 0; x < 29; ++x)
+				{
+					this->T[(j * 29 + x) * WIDTH + k] = v;
+					v = (v + e) % 29;
+				}
+			}
+		}
+	}
+}
+
+unsigned int ColumnTable::size() const
+{
+	return this->n;
+}
+
+const Matrix ColumnTable::mult(const Matrix& P) const
+{
+	if (this->n == 0 || P.size(1) != this->n)
+	{
+		std::vector<int> vec;
+		Matrix res(vec, 0, 0);
+		return res;
+	}
+
+	unsigned int blocks = P.size(2);
+	std::vector<int> out(this->n * blocks);
+	for (unsigned int b = 0; b < blocks; ++b)
+	{
+		uint16_t acc[WIDTH] = { 0 };
+		for (unsigned int j = 0; j < this->n; ++j)
+		{
+			int x = P.get(b * this->n + j) % 29;
+			if (x < 0)
+			{
+				x += 29;
+			}
+			const uint16_t* t = &this->T[(j * 29 + x) * WIDTH];
+			for (unsigned int k = 0; k < WIDTH; ++k)
+			{
+				acc[k] += t[k];
+			}
+		}
+		//at most 16*28 = 448 per lane, so one reduction at the end suffices
+		for (unsigned int k = 0; k < this->n; ++k)
+		{
+			out[b * this->n + k] = acc[k] % 29;
+		}
+	}
+	Matrix res(out, this->n, blocks);
+	return res;
+}
+
+void ColumnTable::apply(const uint8_t* in, uint8_t* out, size_t blocks, size_t stride) const
+{
+	for (size_t b = 0; b < blocks; ++b)
+	{
+		uint16_t acc[WIDTH] = { 0 };
+		for (unsigned int j = 0; j < this->n; ++j)
+		{
+			const uint16_t* t = &this->T[(j * 29 + in[j * stride + b]) * WIDTH];
+			for (unsigned int k = 0; k < WIDTH; ++k)
+			{
+				acc[k] += t[k];
+			}
+		}
+		for (unsigned int k = 0; k < this->n; ++k)
+		{
+			out[k * stride + b] = static_cast<uint8_t>(acc[k] % 29);
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef _COLUMNTABLE_HPP_
+#define _COLUMNTABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.hpp"
+
+/**
+ * Table-driven block transform for n-by-n keys with 4 <= n <= 16.  The product E*p mod 29 is computed as the sum over
+ * columns j of T_j[p_j], where T_j[x] holds x times column j of E (mod 29) packed into one WIDTH-lane word.  Each block
+ * therefore costs n lookups and n packed adds followed by a single reduction, with no multiplications in the inner loop.
+ */ 
+class ColumnTable
+{
+public:
+  //smallest/largest key size served by the tables
+  static const unsigned int MIN_SIZE = 4;
+  static const unsigned int MAX_SIZE = 16;
+  //number of 16-bit lanes in one packed table entry (one 256-bit word)
+  static const unsigned int WIDTH = 16;
+
+  /**
+   * Default constructor. It creates an empty table (size() == 0) that cannot be applied.
+   */ 
+  ColumnTable();
+
+  /**
+   * Parameterized constructor.  Precomputes the n column tables of K; if K is not square with MIN_SIZE <= n <= MAX_SIZE then create an empty table.
+   * @param K - the key matrix (encryption or decryption) to tabulate.
+   */ 
+  ColumnTable(const Matrix &K);
+
+  /**
+   * Returns the key size the table was built for.
+   * @return n for an n-by-n key, 0 if the table is empty.
+   */ 
+  unsigned int size() const;
+
+  /**
+   * Creates and returns K*P mod 29, i.e., the same blocks as K.mult(P) after reduction mod 29.
+   * @param P - an n-by-N matrix of symbols, one block per column (as produced by Hill::l2num).
+   * @return the n-by-N transformed blocks with elements in [0,29), a 0-by-0 matrix if P does not match the table.
+   */ 
+  const Matrix mult( const Matrix &P ) const;
+
+  /**
+   * Applies the tables to interleaved blocks (symbol j of block b at in[j*stride + b]); in and out may be the same buffer.
+   * @param in - n planes of symbols in [0,29).
+   * @param out - n planes receiving K*p mod 29, same layout as in.
+   * @param blocks - number of blocks to transform.
+   * @param stride - distance between planes.
+   */ 
+  void apply( const uint8_t *in, uint8_t *out, size_t blocks, size_t stride ) const;
+
+private:
+  unsigned int n; //key size, 0 if empty
+  std::vector<uint16_t> T; //T[(j*29 + x)*WIDTH + k] = x*K(k,j) mod 29, lanes k >= n are zero
+};
+#endif
@@ -0,0 +1,297 @@
+#include "Container.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	const char MAGIC[4] = { 'H', '2', '9', 'C' };
+	const char INDEX_MAGIC[4] = { 'H', '2', '9', 'I' };
+	const unsigned char VERSION = 1;
+
+	void put64(char* p, uint64_t v)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			p[i] = static_cast<char>(v >> (8 * i));
+		}
+	}
+
+	uint64_t get64(const char* p)
+	{
+		uint64_t v = 0;
+		for (int i = 7; i >= 0; --i)
+		{
+			v = (v << 8) | static_cast<unsigned char>(p[i]);
+		}
+		return v;
+	}
+}
+
+Container::Container()
+{
+	this->n = 0;
+	this->segmentSize = 0;
+	this->total = 0;
+}
+
+bool Container::write(const std::string& path, const char* P, size_t size, const BlockKernel& K, size_t segment, unsigned int threads)
+{
+	//the header keeps n in one byte; a larger n would be read back as n mod 256
+	if (K.size() == 0 || K.size() > MAX_BLOCK)
+	{
+		return false;
+	}
+	segment = K.padded(segment ? segment : 1);
+
+	//every segment but the last is exactly segment characters, so the whole layout is known before encrypting
+	std::vector<Segment> entries;
+	uint64_t offset = HEADER;
+	for (size_t start = 0; start < size; start += segment)
+	{
+		Segment s;
+		s.plainLength = (size - start < segment) ? size - start : segment;
+		s.cipherLength = K.padded(s.plainLength);
+		s.offset = offset;
+		s.checksum = 0;
+		offset += s.cipherLength;
+		entries.push_back(s);
+	}
+	uint64_t indexOffset = offset;
+
+	MappedFile out;
+	if (!out.create(path, indexOffset + entries.size() * ENTRY + TRAILER))
+	{
+		return false;
+	}
+	char* base = out.writableData();
+
+	for (int i = 0; i < 4; ++i)
+	{
+		base[i] = MAGIC[i];
+	}
+	base[4] = static_cast<char>(VERSION);
+	base[5] = static_cast<char>(K.size());
+	base[6] = base[7] = 0;
+	put64(base + 8, segment);
+
+	{
+		ThreadPool pool(threads);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			pool.submit([&, i]() {
+				Segment& s = entries[i];
+				K.text(P + i * segment, s.plainLength, base + s.offset);
+				s.checksum = checksum(base + s.offset, s.cipherLength);
+			});
+		}
+		pool.wait();
+	}
+
+	char* p = base + indexOffset;
+	for (size_t i = 0; i < entries.size(); ++i, p += ENTRY)
+	{
+		put64(p, entries[i].offset);
+		put64(p + 8, entries[i].cipherLength);
+		put64(p + 16, entries[i].plainLength);
+		put64(p + 24, entries[i].checksum);
+	}
+	put64(p, entries.size());
+	put64(p + 8, indexOffset);
+	for (int i = 0; i < 4; ++i)
+	{
+		p[16 + i] = INDEX_MAGIC[i];
+	}
+	return true;
+}
+
+uint64_t Container::checksum(const char* data, size_t size)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; ++i)
+	{
+		h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+	}
+	return h;
+}
+
+bool Container::open(const std::string& path)
+{
+	this->n = 0;
+	this->entries.clear();
+	if (!this->file.openRead(path) || this->file.size() < HEADER + TRAILER)
+	{
+		return false;
+	}
+	const char* base = this->file.data();
+	size_t size = this->file.size();
+	const char* trailer = base + size - TRAILER;
+	if (std::string(base, 4) != std::string(MAGIC, 4) || static_cast<unsigned char>(base[4]) != VERSION
+		|| std::string(trailer + 16, 4) != std::string(INDEX_MAGIC, 4))
+	{
+		return false;
+	}
+
+	uint64_t count = get64(trailer);
+	uint64_t indexOffset = get64(trailer + 8);
+	if (indexOffset < HEADER || indexOffset > size - TRAILER || (size - TRAILER - indexOffset) / ENTRY != count
+		|| (size - TRAILER - indexOffset) % ENTRY != 0)
+	{
+		return false;
+	}
+
+	unsigned int n = static_cast<unsigned char>(base[5]);
+	uint64_t segmentSize = get64(base + 8);
+	if (n < 2 || segmentSize == 0 || segmentSize % n != 0)
+	{
+		return false;
+	}
+
+	//the index must match what write() lays out, or range() (which skips checksums) could read past a segment
+	uint64_t sum = 0;
+	uint64_t expected = HEADER; //where the next segment has to start
+	const char* p = base + indexOffset;
+	for (uint64_t i = 0; i < count; ++i, p += ENTRY)
+	{
+		Segment s;
+		s.offset = get64(p);
+		s.cipherLength = get64(p + 8);
+		s.plainLength = get64(p + 16);
+		s.checksum = get64(p + 24);
+		bool last = (i + 1 == count);
+		if (s.offset != expected || s.cipherLength > indexOffset - s.offset || s.plainLength == 0
+			|| (last ? s.plainLength > segmentSize : s.plainLength != segmentSize)
+			|| s.cipherLength != (s.plainLength + n - 1) / n * n)
+		{
+			this->entries.clear();
+			return false;
+		}
+		expected += s.cipherLength;
+		sum += s.plainLength;
+		this->entries.push_back(s);
+	}
+	if (expected != indexOffset)
+	{
+		this->entries.clear();
+		return false;
+	}
+	this->n = n;
+	this->segmentSize = segmentSize;
+	this->total = sum;
+	return true;
+}
+
+bool Container::sameFile(const std::string& path) const
+{
+	return this->file.sameFile(path);
+}
+
+unsigned int Container::blockSize() const
+{
+	return this->n;
+}
+
+uint64_t Container::length() const
+{
+	return this->total;
+}
+
+const std::vector<Container::Segment>& Container::index() const
+{
+	return this->entries;
+}
+
+bool Container::segment(size_t i, const BlockKernel& K, std::string& out) const
+{
+	if (i >= this->entries.size() || K.size() != this->n)
+	{
+		return false;
+	}
+	const Segment& s = this->entries[i];
+	const char* c = this->file.data() + s.offset;
+	if (checksum(c, s.cipherLength) != s.checksum)
+	{
+		return false;
+	}
+	out.assign(s.cipherLength, ' ');
+	K.text(c, s.cipherLength, &out[0]);
+	out.resize(s.plainLength);
+	return true;
+}
+
+bool Container::decrypt(const BlockKernel& K, char* out, unsigned int threads) const
+{
+	if (this->n == 0 || K.size() != this->n)
+	{
+		return false;
+	}
+	std::vector<uint64_t> start(this->entries.size() + 1, 0);
+	for (size_t i = 0; i < this->entries.size(); ++i)
+	{
+		start[i + 1] = start[i] + this->entries[i].plainLength;
+	}
+
+	std::atomic<bool> ok(true);
+	{
+		ThreadPool pool(threads);
+		for (size_t i = 0; i < this->entries.size(); ++i)
+		{
+			pool.submit([&, i]() {
+				const Segment& s = this->entries[i];
+				const char* c = this->file.data() + s.offset;
+				if (checksum(c, s.cipherLength) != s.checksum || s.cipherLength != K.padded(s.plainLength))
+				{
+					ok = false;
+				}
+				else if (s.cipherLength == s.plainLength)
+				{
+					K.text(c, s.cipherLength, out + start[i]);
+				}
+				else
+				{
+					//padded segment (the last one): decrypt aside and keep only the real characters
+					std::string tail(s.cipherLength, ' ');
+					K.text(c, s.cipherLength, &tail[0]);
+					std::copy(tail.begin(), tail.begin() + s.plainLength, out + start[i]);
+				}
+			});
+		}
+		pool.wait();
+	}
+	return ok;
+}
+
+bool Container::decrypt(const BlockKernel& K, std::string& out, unsigned int threads) const
+{
+	out.assign(this->total, ' ');
+	return out.empty() ? (this->n != 0 && K.size() == this->n) : this->decrypt(K, &out[0], threads);
+}
+
+std::string Container::range(const BlockKernel& K, uint64_t offset, size_t length) const
+{
+	if (this->n == 0 || K.size() != this->n || offset >= this->total)
+	{
+		return "";
+	}
+	std::string result;
+	size_t i = static_cast<size_t>(offset / this->segmentSize);
+	uint64_t local = offset - i * this->segmentSize;
+	while (length > 0 && i < this->entries.size())
+	{
+		const Segment& s = this->entries[i];
+		uint64_t end = (length < s.plainLength - local) ? local + length : s.plainLength;
+
+		//widen to whole blocks within the segment, decrypt only those and trim
+		uint64_t first = local / this->n * this->n;
+		uint64_t last = K.padded(end);
+		std::string blocks(last - first, ' ');
+		K.text(this->file.data() + s.offset + first, last - first, &blocks[0]);
+		result.append(blocks, local - first, end - local);
+
+		length -= end - local;
+		local = 0;
+		++i;
+	}
+	return result;
+}
@@ -0,0 +1,143 @@
+#ifndef _CONTAINER_HPP_
+#define _CONTAINER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "MappedFile.hpp"
+
+/**
+ * Indexed ciphertext container: the plaintext is cut into fixed-size segments (a whole number of blocks each) that are
+ * encrypted independently, followed by a footer index, so readers can decode segments in parallel or jump straight to
+ * the segment holding any plaintext offset.  Layout, all integers little-endian:
+ *   header   16 bytes: magic "H29C", version (1), block size n, 2 reserved, segment size (plaintext characters, u64)
+ *   segments ciphertext text of each segment, back to back; only the last one is padded with '.'
+ *   index    32 bytes per segment: offset, ciphertext length, plaintext length, FNV-1a checksum of the ciphertext
+ *   trailer  24 bytes: segment count, index offset, magic "H29I" and 4 reserved
+ * Padding of a segment is its ciphertext length minus its plaintext length.
+ */ 
+class Container
+{
+public:
+  static const size_t HEADER = 16;
+  static const size_t ENTRY = 32;
+  static const size_t TRAILER = 24;
+  static const unsigned int MAX_BLOCK = 255; //largest block size the one-byte header field holds
+
+  /**
+   * Default constructor. It creates a reader with no container open.
+   */ 
+  Container();
+
+  //index entry for one segment
+  struct Segment
+  {
+    uint64_t offset; //file offset of the ciphertext
+    uint64_t cipherLength;
+    uint64_t plainLength;
+    uint64_t checksum; //FNV-1a of the ciphertext bytes
+  };
+
+  /**
+   * Encrypts P into a new container file; segments are encrypted on a thread pool directly into the mapped output.
+   * @param path - the container file to create (overwritten if it exists).
+   * @param P - the plaintext.
+   * @param size - number of characters in P.
+   * @param K - the prepared encryption key.
+   * @param segment - plaintext characters per segment, rounded up to a whole number of blocks.
+   * @param threads - number of worker threads, 0 for one per hardware thread.
+   * @return true if the container was written, false if K is empty or larger than MAX_BLOCK, or the file could not be
+   *         created.
+   */ 
+  static bool write( const std::string &path, const char *P, size_t size, const BlockKernel &K, size_t segment = 1 << 20, unsigned int threads = 0 );
+
+  /**
+   * Returns the FNV-1a 64-bit checksum used for segments.
+   * @param data - bytes to hash.
+   * @param size - number of bytes.
+   * @return the checksum.
+   */ 
+  static uint64_t checksum( const char *data, size_t size );
+
+  /**
+   * Maps a container file and reads its index.  The index must describe the layout write() produces: segments back to
+   * back from the header to the index, every one but the last holding exactly the segment size, and each ciphertext
+   * length the plaintext length padded to whole blocks.  range() relies on this, since it skips the checksums.
+   * @param path - the container file.
+   * @return true if the file is a well-formed container, false otherwise.
+   */ 
+  bool open( const std::string &path );
+
+  /**
+   * Tells whether a path names the open container file itself, see MappedFile::sameFile.
+   * @param path - the path to compare.
+   * @return true if path is the open container file.
+   */ 
+  bool sameFile( const std::string &path ) const;
+
+  /**
+   * Returns the block size the container was written with.
+   * @return n, 0 if no container is open.
+   */ 
+  unsigned int blockSize() const;
+
+  /**
+   * Returns the total plaintext length.
+   * @return the sum of the segment plaintext lengths.
+   */ 
+  uint64_t length() const;
+
+  /**
+   * Returns the segment index.
+   * @return one entry per segment, in plaintext order.
+   */ 
+  const std::vector<Segment> & index() const;
+
+  /**
+   * Decrypts one segment after verifying its checksum.
+   * @param i - segment number.
+   * @param K - the prepared decryption key; its size must match blockSize().
+   * @param out - receives the segment plaintext (padding removed).
+   * @return true if the segment was decrypted, false on a bad index, key size or checksum.
+   */ 
+  bool segment( size_t i, const BlockKernel &K, std::string &out ) const;
+
+  /**
+   * Decrypts the whole container, one segment per task on a thread pool, each written at its own offset.
+   * @param K - the prepared decryption key; its size must match blockSize().
+   * @param out - receives length() characters of plaintext.
+   * @param threads - number of worker threads, 0 for one per hardware thread.
+   * @return true if every segment was decrypted and verified, false otherwise.
+   */ 
+  bool decrypt( const BlockKernel &K, std::string &out, unsigned int threads = 0 ) const;
+
+  /**
+   * Decrypts the whole container into a caller-provided buffer (e.g. a mapped output file).
+   * @param K - the prepared decryption key; its size must match blockSize().
+   * @param out - receives length() characters of plaintext.
+   * @param threads - number of worker threads, 0 for one per hardware thread.
+   * @return true if every segment was decrypted and verified, false otherwise.
+   */ 
+  bool decrypt( const BlockKernel &K, char *out, unsigned int threads = 0 ) const;
+
+  /**
+   * Decrypts a plaintext range, finding the first segment in O(1) from the fixed segment size.  Only the blocks covering
+   * the range are decrypted, so checksums are not verified here (that would mean hashing whole segments).
+   * @param K - the prepared decryption key; its size must match blockSize().
+   * @param offset - first plaintext character wanted.
+   * @param length - number of characters wanted.
+   * @return the plaintext characters (fewer at the end of the container), an empty string on error.
+   */ 
+  std::string range( const BlockKernel &K, uint64_t offset, size_t length ) const;
+
+private:
+  MappedFile file;
+  unsigned int n; //block size, 0 if nothing is open
+  uint64_t segmentSize; //plaintext characters per segment (all but the last)
+  uint64_t total; //plaintext length
+  std::vector<Segment> entries;
+};
+#endif
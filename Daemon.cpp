@@ -0,0 +1,403 @@
+#include "Daemon.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	void put32(char* p, uint32_t v)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			p[i] = static_cast<char>(v >> (8 * i));
+		}
+	}
+
+	uint32_t get32(const char* p)
+	{
+		uint32_t v = 0;
+		for (int i = 3; i >= 0; --i)
+		{
+			v = (v << 8) | static_cast<unsigned char>(p[i]);
+		}
+		return v;
+	}
+}
+
+void Frame::encode(char* p) const
+{
+	put32(p, this->length);
+	put32(p + 4, this->id);
+	p[8] = static_cast<char>(this->op);
+	p[9] = static_cast<char>(this->status);
+	p[10] = 0;
+	p[11] = 0;
+}
+
+void Frame::decode(const char* p)
+{
+	this->length = get32(p);
+	this->id = get32(p + 4);
+	this->op = static_cast<uint8_t>(p[8]);
+	this->status = static_cast<uint8_t>(p[9]);
+}
+
+Daemon::Daemon(Hill& H, size_t batch)
+	: H(H)
+{
+	this->batch = batch ? batch : 1;
+	this->listener = -1;
+	this->epoll = -1;
+	this->wake = -1;
+}
+
+Daemon::~Daemon()
+{
+	while (!this->connections.empty())
+	{
+		this->close(this->connections.begin()->first);
+	}
+	if (this->listener >= 0)
+	{
+		::close(this->listener);
+		::unlink(this->path.c_str());
+	}
+	if (this->epoll >= 0)
+	{
+		::close(this->epoll);
+	}
+	if (this->wake >= 0)
+	{
+		::close(this->wake);
+	}
+}
+
+bool Daemon::listen(const std::string& path)
+{
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (this->listener >= 0 || path.size() >= sizeof(addr.sun_path))
+	{
+		return false;
+	}
+	std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+	this->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+	this->wake = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	this->listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (this->epoll < 0 || this->wake < 0 || this->listener < 0)
+	{
+		return false;
+	}
+	::unlink(path.c_str());
+	if (::bind(this->listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(this->listener, SOMAXCONN) != 0)
+	{
+		::close(this->listener);
+		this->listener = -1;
+		return false;
+	}
+	this->path = path;
+
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = this->listener;
+	::epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->listener, &ev);
+	ev.data.fd = this->wake;
+	::epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->wake, &ev);
+	return true;
+}
+
+bool Daemon::run()
+{
+	if (this->listener < 0)
+	{
+		return false;
+	}
+	const int EVENTS = 256;
+	epoll_event events[EVENTS];
+	for (;;)
+	{
+		int ready = ::epoll_wait(this->epoll, events, EVENTS, -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		//read everything that is ready before running the kernel, so requests from all clients share a batch
+		bool stopping = false;
+		for (int e = 0; e < ready; ++e)
+		{
+			int fd = events[e].data.fd;
+			if (fd == this->wake)
+			{
+				stopping = true;
+				continue;
+			}
+			if (fd == this->listener)
+			{
+				this->accept();
+				continue;
+			}
+			std::map<int, Connection>::iterator c = this->connections.find(fd);
+			if (c == this->connections.end())
+			{
+				continue;
+			}
+			if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			{
+				this->receive(fd, c->second);
+			}
+			if ((events[e].events & EPOLLOUT) && !c->second.closing)
+			{
+				this->flush(fd, c->second);
+			}
+		}
+		this->process();
+
+		//connections are only closed here, so a descriptor is never reused while a request still refers to it
+		for (std::map<int, Connection>::iterator c = this->connections.begin(); c != this->connections.end();)
+		{
+			int fd = c->first;
+			bool closing = c->second.closing || (c->second.eof && c->second.out.empty());
+			++c;
+			if (closing)
+			{
+				this->close(fd);
+			}
+		}
+		if (stopping)
+		{
+			return true;
+		}
+	}
+}
+
+void Daemon::stop()
+{
+	uint64_t one = 1;
+	if (this->wake >= 0)
+	{
+		ssize_t ignored = ::write(this->wake, &one, sizeof(one));
+		(void)ignored;
+	}
+}
+
+//Private section
+void Daemon::accept()
+{
+	for (;;)
+	{
+		int fd = ::accept4(this->listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			return;
+		}
+		Connection& c = this->connections[fd];
+		c.sent = 0;
+		c.events = EPOLLIN;
+		c.eof = false;
+		c.closing = false;
+
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		::epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+//drain the socket, then cut complete frames off the front of the buffer; a frame split across reads waits in c.in.
+//At most one largest frame is buffered per call; the rest stays in the socket, which epoll reports again.
+void Daemon::receive(int fd, Connection& c)
+{
+	char buffer[64 << 10];
+	while (c.in.size() < Frame::HEADER + Frame::MAX_PAYLOAD)
+	{
+		ssize_t got = ::read(fd, buffer, sizeof(buffer));
+		if (got > 0)
+		{
+			c.in.append(buffer, static_cast<size_t>(got));
+			continue;
+		}
+		if (got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (got == 0)
+		{
+			//the client has sent everything; stop watching for input but keep the connection until its replies are out
+			c.eof = true;
+		}
+		else if (errno != EAGAIN)
+		{
+			c.closing = true;
+		}
+		break;
+	}
+
+	size_t pos = 0;
+	while (c.in.size() - pos >= Frame::HEADER)
+	{
+		Frame f;
+		f.decode(&c.in[pos]);
+		if (f.length > Frame::MAX_PAYLOAD)
+		{
+			c.closing = true;
+			break;
+		}
+		if (c.in.size() - pos - Frame::HEADER < f.length)
+		{
+			break;
+		}
+		Request r;
+		r.fd = fd;
+		r.id = f.id;
+		r.op = f.op;
+		if (f.op == Frame::ENCRYPT || f.op == Frame::DECRYPT)
+		{
+			this->slots[f.op].push_back(this->requests.size());
+			this->texts[f.op].push_back(c.in.substr(pos + Frame::HEADER, f.length));
+		}
+		this->requests.push_back(r);
+		pos += Frame::HEADER + f.length;
+
+		if (this->requests.size() >= this->batch)
+		{
+			this->process();
+		}
+	}
+	c.in.erase(0, pos);
+	this->watch(fd, c);
+}
+
+//one kernel pass per operation over everything parsed since the last batch
+void Daemon::process()
+{
+	if (this->requests.empty())
+	{
+		return;
+	}
+	std::string out[2];
+	std::vector<size_t> offsets[2];
+	this->H.encryptBatch(this->texts[Frame::ENCRYPT], out[Frame::ENCRYPT], offsets[Frame::ENCRYPT]);
+	this->H.decryptBatch(this->texts[Frame::DECRYPT], out[Frame::DECRYPT], offsets[Frame::DECRYPT]);
+
+	std::vector<bool> done(this->requests.size(), false);
+	for (int op = 0; op < 2; ++op)
+	{
+		for (size_t i = 0; i < this->slots[op].size(); ++i)
+		{
+			const Request& r = this->requests[this->slots[op][i]];
+			Connection& c = this->connections[r.fd];
+			Frame f;
+			f.id = r.id;
+			f.op = r.op;
+			f.status = Frame::OK;
+			f.length = static_cast<uint32_t>(offsets[op][i + 1] - offsets[op][i]);
+			char header[Frame::HEADER];
+			f.encode(header);
+			c.out.append(header, Frame::HEADER);
+			c.out.append(out[op], offsets[op][i], f.length);
+			done[this->slots[op][i]] = true;
+		}
+		this->texts[op].clear();
+		this->slots[op].clear();
+	}
+
+	//unknown operations get an empty error reply
+	for (size_t i = 0; i < this->requests.size(); ++i)
+	{
+		if (!done[i])
+		{
+			Frame f;
+			f.id = this->requests[i].id;
+			f.op = this->requests[i].op;
+			f.status = Frame::BAD_REQUEST;
+			f.length = 0;
+			char header[Frame::HEADER];
+			f.encode(header);
+			this->connections[this->requests[i].fd].out.append(header, Frame::HEADER);
+		}
+	}
+
+	for (size_t i = 0; i < this->requests.size(); ++i)
+	{
+		int fd = this->requests[i].fd;
+		Connection& c = this->connections[fd];
+		if (!c.closing && c.sent < c.out.size())
+		{
+			this->flush(fd, c);
+		}
+	}
+	this->requests.clear();
+}
+
+//write as much as the socket takes; watch for EPOLLOUT only while replies are left over
+void Daemon::flush(int fd, Connection& c)
+{
+	while (c.sent < c.out.size())
+	{
+		ssize_t put = ::write(fd, c.out.data() + c.sent, c.out.size() - c.sent);
+		if (put > 0)
+		{
+			c.sent += static_cast<size_t>(put);
+		}
+		else if (put < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else
+		{
+			if (put < 0 && errno != EAGAIN)
+			{
+				c.closing = true;
+			}
+			break;
+		}
+	}
+	if (c.sent == c.out.size())
+	{
+		c.out.clear();
+		c.sent = 0;
+	}
+	this->watch(fd, c);
+}
+
+//EPOLLOUT while replies are left over; EPOLLIN until the client has sent everything, paused while HIGH_WATER reply
+//bytes wait for it so a client that never reads cannot grow out without limit
+void Daemon::watch(int fd, Connection& c)
+{
+	uint32_t events = 0;
+	if (!c.out.empty() && !c.closing)
+	{
+		events |= EPOLLOUT;
+	}
+	if (!c.eof && c.out.size() - c.sent < HIGH_WATER)
+	{
+		events |= EPOLLIN;
+	}
+	if (events != c.events)
+	{
+		epoll_event ev;
+		ev.events = events;
+		ev.data.fd = fd;
+		::epoll_ctl(this->epoll, EPOLL_CTL_MOD, fd, &ev);
+		c.events = events;
+	}
+}
+
+void Daemon::close(int fd)
+{
+	::epoll_ctl(this->epoll, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+	this->connections.erase(fd);
+}
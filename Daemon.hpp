@@ -0,0 +1,129 @@
+#ifndef _DAEMON_HPP_
+#define _DAEMON_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Hill.hpp"
+
+/**
+ * One message of the daemon protocol: a 12-byte header followed by length payload bytes.  Layout, integers little-endian:
+ *   bytes 0-3   payload length
+ *   bytes 4-7   request id, chosen by the client and echoed in the reply
+ *   byte  8     operation (ENCRYPT or DECRYPT)
+ *   byte  9     status, zero in requests
+ *   bytes 10-11 reserved, zero
+ * A reply carries the padded ciphertext (or plaintext) of the request with the same id; replies may arrive in any order.
+ */ 
+struct Frame
+{
+  enum Op { ENCRYPT = 0, DECRYPT = 1 };
+  enum Status { OK = 0, BAD_REQUEST = 1 };
+  static const size_t HEADER = 12;
+  static const uint32_t MAX_PAYLOAD = 1 << 24; //larger requests close the connection
+
+  uint32_t length;
+  uint32_t id;
+  uint8_t op;
+  uint8_t status;
+
+  /**
+   * Writes the header.
+   * @param p - receives HEADER bytes.
+   */ 
+  void encode( char *p ) const;
+
+  /**
+   * Reads a header.
+   * @param p - HEADER bytes.
+   */ 
+  void decode( const char *p );
+};
+
+/**
+ * A local encryption service: one epoll event loop serving many clients on a Unix domain socket.  Every request that
+ * has arrived by the time the loop wakes up is parsed first, then all encryptions go through a single encryptBatch
+ * call and all decryptions through a single decryptBatch call, so concurrent small requests share one pass of the
+ * block kernel.  Replies are queued per connection and written without blocking; a client that shuts down its sending
+ * side still gets the replies to everything it sent before the connection is closed.  A client that sends faster than
+ * it reads stops being read once HIGH_WATER reply bytes wait for it, until it catches up.
+ */ 
+class Daemon
+{
+public:
+  /**
+   * Parameterized constructor.
+   * @param H - the cipher whose keys serve every request; it must outlive run().
+   * @param batch - most requests coalesced into one kernel pass.
+   */ 
+  Daemon(Hill &H, size_t batch = 1024);
+
+  /**
+   * Destructor.  Closes the socket and every connection and removes the socket file.
+   */ 
+  ~Daemon();
+
+  Daemon(const Daemon &) = delete;
+  Daemon & operator=(const Daemon &) = delete;
+
+  /**
+   * Creates the listening socket, replacing a stale socket file at path.
+   * @param path - filesystem path of the Unix domain socket.
+   * @return true if the daemon is listening, false otherwise.
+   */ 
+  bool listen( const std::string & path );
+
+  /**
+   * Serves clients until stop() is called.
+   * @return true on a clean stop, false if listen() has not succeeded or epoll failed.
+   */ 
+  bool run();
+
+  /**
+   * Asks run() to return; safe to call from any thread or a signal handler.
+   */ 
+  void stop();
+
+private:
+  static const size_t HIGH_WATER = 8 << 20; //unwritten reply bytes at which a connection is no longer read
+
+  struct Connection
+  {
+    std::string in; //received bytes not yet parsed into requests
+    std::string out; //replies not yet written
+    size_t sent; //bytes of out already written
+    uint32_t events; //epoll events the descriptor is registered for
+    bool eof; //the client shut down its side; closed once out is written
+    bool closing; //closed after the current batch
+  };
+
+  struct Request
+  {
+    int fd;
+    uint32_t id;
+    uint8_t op;
+  };
+
+  Hill &H;
+  size_t batch;
+  std::string path;
+  int listener;
+  int epoll;
+  int wake; //eventfd written by stop()
+  std::map<int, Connection> connections;
+
+  std::vector<Request> requests; //parsed, waiting for the batch
+  std::vector<std::string> texts[2]; //payloads of requests by operation
+  std::vector<size_t> slots[2]; //index into requests of each payload
+
+  void accept();
+  void receive(int fd, Connection & c);
+  void process();
+  void flush(int fd, Connection & c);
+  void watch(int fd, Connection & c);
+  void close(int fd);
+};
+#endif
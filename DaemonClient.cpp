@@ -0,0 +1,150 @@
+#include "DaemonClient.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+DaemonClient::DaemonClient()
+{
+	this->socket = -1;
+	this->next = 0;
+}
+
+DaemonClient::~DaemonClient()
+{
+	if (this->socket >= 0)
+	{
+		::close(this->socket);
+	}
+}
+
+bool DaemonClient::connect(const std::string& path)
+{
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (this->socket >= 0 || path.size() >= sizeof(addr.sun_path))
+	{
+		return false;
+	}
+	std::memcpy(addr.sun_path, path.c_str(), path.size());
+	this->socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (this->socket < 0)
+	{
+		return false;
+	}
+	if (::connect(this->socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+	{
+		::close(this->socket);
+		this->socket = -1;
+		return false;
+	}
+	return true;
+}
+
+//header and payload leave in one writev, so a small request is a single syscall
+bool DaemonClient::send(uint32_t id, uint8_t op, const std::string& text)
+{
+	Frame f;
+	f.length = static_cast<uint32_t>(text.size());
+	f.id = id;
+	f.op = op;
+	f.status = Frame::OK;
+	char header[Frame::HEADER];
+	f.encode(header);
+
+	iovec iov[2];
+	iov[0].iov_base = header;
+	iov[0].iov_len = Frame::HEADER;
+	iov[1].iov_base = const_cast<char*>(text.data());
+	iov[1].iov_len = text.size();
+	size_t left = Frame::HEADER + text.size();
+	int first = 0;
+	while (left > 0)
+	{
+		ssize_t put = ::writev(this->socket, iov + first, 2 - first);
+		if (put < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		left -= static_cast<size_t>(put);
+		size_t done = static_cast<size_t>(put);
+		while (first < 2 && done >= iov[first].iov_len)
+		{
+			done -= iov[first].iov_len;
+			++first;
+		}
+		if (first < 2)
+		{
+			iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+			iov[first].iov_len -= done;
+		}
+	}
+	return true;
+}
+
+bool DaemonClient::receive(uint32_t& id, uint8_t& status, std::string& text)
+{
+	char header[Frame::HEADER];
+	if (!this->readFully(header, Frame::HEADER))
+	{
+		return false;
+	}
+	Frame f;
+	f.decode(header);
+	if (f.length > Frame::MAX_PAYLOAD)
+	{
+		return false;
+	}
+	text.resize(f.length);
+	if (f.length && !this->readFully(&text[0], f.length))
+	{
+		return false;
+	}
+	id = f.id;
+	status = f.status;
+	return true;
+}
+
+bool DaemonClient::call(uint8_t op, const std::string& text, std::string& result)
+{
+	uint32_t id = this->next++;
+	uint32_t got;
+	uint8_t status;
+	if (!this->send(id, op, text) || !this->receive(got, status, result))
+	{
+		return false;
+	}
+	return got == id && status == Frame::OK;
+}
+
+int DaemonClient::fd() const
+{
+	return this->socket;
+}
+
+//Private section
+bool DaemonClient::readFully(char* p, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t got = ::read(this->socket, p, size);
+		if (got > 0)
+		{
+			p += got;
+			size -= static_cast<size_t>(got);
+		}
+		else if (!(got < 0 && errno == EINTR))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef _DAEMONCLIENT_HPP_
+#define _DAEMONCLIENT_HPP_
+
+#include <cstdint>
+#include <string>
+
+#include "Daemon.hpp"
+
+/**
+ * A blocking client for Daemon.  Requests can be pipelined: send several, then receive the replies, matching them by id.
+ */ 
+class DaemonClient
+{
+public:
+  /**
+   * Default constructor.  It creates an unconnected client.
+   */ 
+  DaemonClient();
+
+  /**
+   * Destructor.  Closes the connection.
+   */ 
+  ~DaemonClient();
+
+  DaemonClient(const DaemonClient &) = delete;
+  DaemonClient & operator=(const DaemonClient &) = delete;
+
+  /**
+   * Connects to a daemon.
+   * @param path - filesystem path of the daemon's Unix domain socket.
+   * @return true if connected, false otherwise.
+   */ 
+  bool connect( const std::string & path );
+
+  /**
+   * Sends one request without waiting for the reply.
+   * @param id - request id echoed in the reply.
+   * @param op - Frame::ENCRYPT or Frame::DECRYPT.
+   * @param text - the text to transform.
+   * @return true if the whole request was written, false otherwise.
+   */ 
+  bool send( uint32_t id, uint8_t op, const std::string & text );
+
+  /**
+   * Waits for the next reply.
+   * @param id - receives the id of the request it answers.
+   * @param status - receives Frame::OK or an error status.
+   * @param text - receives the transformed text.
+   * @return true if a reply was read, false if the connection failed or closed.
+   */ 
+  bool receive( uint32_t & id, uint8_t & status, std::string & text );
+
+  /**
+   * Sends one request and waits for its reply; the simplest use when nothing else is in flight.
+   * @param op - Frame::ENCRYPT or Frame::DECRYPT.
+   * @param text - the text to transform.
+   * @param result - receives the transformed text.
+   * @return true if the daemon answered with Frame::OK, false otherwise.
+   */ 
+  bool call( uint8_t op, const std::string & text, std::string & result );
+
+  /**
+   * Returns the socket descriptor, e.g. for polling.
+   * @return the connected descriptor, or -1.
+   */ 
+  int fd() const;
+
+private:
+  int socket;
+  uint32_t next; //id used by call()
+
+  bool readFully(char * p, size_t size);
+};
+#endif
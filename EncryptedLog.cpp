@@ -0,0 +1,250 @@
+#include "EncryptedLog.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+EncryptedLog::EncryptedLog(const BlockKernel& K, size_t groupBytes, unsigned int delay, bool sync)
+	: K(K), appended(0), written(0), grouped(0), sleeping(false), opened(false), appending(0), stopping(false), failed(false)
+{
+	this->taken = 0;
+	this->groupBytes = groupBytes ? groupBytes : 1;
+	this->delay = delay;
+	this->sync = sync;
+	this->fd = -1;
+	this->tail = new Node;
+	this->tail->next.store(nullptr, std::memory_order_relaxed);
+	this->head.store(this->tail, std::memory_order_relaxed);
+}
+
+EncryptedLog::~EncryptedLog()
+{
+	this->close();
+	while (Node* n = this->pop())
+	{
+		delete n;
+	}
+	delete this->tail;
+}
+
+bool EncryptedLog::open(const std::string& path)
+{
+	if (this->fd >= 0 || this->K.size() == 0)
+	{
+		return false;
+	}
+	this->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (this->fd < 0)
+	{
+		return false;
+	}
+	this->stopping = false;
+	this->failed = false;
+	this->writer = std::thread(&EncryptedLog::run, this);
+	this->opened.store(true);
+	return true;
+}
+
+//one exchange and one store; the system call to wake the writer only happens when it has gone to sleep
+bool EncryptedLog::append(const std::string& record)
+{
+	//announce the push before checking opened; close() clears opened first and then waits for appending to drain,
+	//so either this sees the log closed or close() sees this push and the writer still takes it
+	this->appending.fetch_add(1, std::memory_order_seq_cst);
+	if (!this->opened.load(std::memory_order_seq_cst) || this->failed.load(std::memory_order_relaxed))
+	{
+		this->appending.fetch_sub(1, std::memory_order_release);
+		return false;
+	}
+	Node* n = new Node;
+	n->next.store(nullptr, std::memory_order_relaxed);
+	n->text = record;
+	Node* prev = this->head.exchange(n, std::memory_order_acq_rel);
+	prev->next.store(n, std::memory_order_release);
+	this->appended.fetch_add(1, std::memory_order_seq_cst);
+	this->appending.fetch_sub(1, std::memory_order_release);
+	if (this->sleeping.load(std::memory_order_seq_cst))
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->wake.notify_one();
+	}
+	return true;
+}
+
+bool EncryptedLog::flush()
+{
+	uint64_t target = this->appended.load();
+	std::unique_lock<std::mutex> guard(this->lock);
+	this->done.wait(guard, [&]() { return this->written.load() >= target || this->failed.load() || this->fd < 0; });
+	return this->written.load() >= target && !this->failed.load();
+}
+
+bool EncryptedLog::close()
+{
+	if (!this->opened.exchange(false, std::memory_order_seq_cst))
+	{
+		return !this->failed;
+	}
+	while (this->appending.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->stopping = true;
+		this->wake.notify_one();
+	}
+	this->writer.join();
+	::close(this->fd);
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->fd = -1;
+	}
+	this->done.notify_all();
+	return !this->failed;
+}
+
+uint64_t EncryptedLog::groups() const
+{
+	return this->grouped.load();
+}
+
+//Private section
+//Vyukov's intrusive queue: the node after the stub is the oldest record; it becomes the new stub
+EncryptedLog::Node* EncryptedLog::pop()
+{
+	Node* next = this->tail->next.load(std::memory_order_acquire);
+	if (!next)
+	{
+		return nullptr;
+	}
+	Node* old = this->tail;
+	this->tail = next;
+	old->text.swap(next->text);
+	return old;
+}
+
+void EncryptedLog::run()
+{
+	std::vector<Node*> group;
+	for (;;)
+	{
+		size_t bytes = 0;
+		group.clear();
+		std::chrono::steady_clock::time_point deadline;
+		while (group.size() < MAX_RECORDS && bytes < this->groupBytes)
+		{
+			Node* n = this->pop();
+			if (n)
+			{
+				if (group.empty())
+				{
+					deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(this->delay);
+				}
+				bytes += n->text.length();
+				group.push_back(n);
+				++this->taken;
+				continue;
+			}
+			//a producer may have swapped head but not linked its node yet; appended tells us it is coming
+			if (this->appended.load() > this->taken)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			if (group.empty() && this->stopping.load())
+			{
+				return;
+			}
+			if (!group.empty() && (this->stopping.load() || std::chrono::steady_clock::now() >= deadline))
+			{
+				break;
+			}
+			//sleep until a record arrives: indefinitely (in 50 ms steps) when idle, until the deadline inside a group
+			std::unique_lock<std::mutex> guard(this->lock);
+			this->sleeping.store(true, std::memory_order_seq_cst);
+			std::chrono::steady_clock::time_point until = group.empty() ? std::chrono::steady_clock::now() + std::chrono::milliseconds(50) : deadline;
+			this->wake.wait_until(guard, until, [&]() { return this->appended.load() > this->taken || this->stopping.load(); });
+			this->sleeping.store(false, std::memory_order_relaxed);
+		}
+
+		if (!this->failed && !this->write(&group[0], group.size()))
+		{
+			this->failed = true;
+		}
+		for (size_t i = 0; i < group.size(); ++i)
+		{
+			delete group[i];
+		}
+		{
+			std::lock_guard<std::mutex> guard(this->lock);
+			this->written.fetch_add(group.size());
+			this->grouped.fetch_add(1);
+		}
+		this->done.notify_all();
+	}
+}
+
+//records are padded to whole blocks independently, so the concatenation of the padded records goes through the
+//kernel in one call; the iovecs then interleave the ciphertext slices with newlines
+bool EncryptedLog::write(Node** group, size_t count)
+{
+	std::vector<size_t> offsets(count + 1, 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		offsets[i + 1] = offsets[i] + this->K.padded(group[i]->text.length());
+	}
+	std::string plain(offsets[count], '.');
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::memcpy(&plain[offsets[i]], group[i]->text.data(), group[i]->text.length());
+	}
+	std::string cipher(offsets[count], ' ');
+	if (!plain.empty())
+	{
+		this->K.text(plain.data(), plain.length(), &cipher[0]);
+	}
+
+	static char newline = '\n';
+	std::vector<iovec> iov(2 * count);
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		iov[2 * i].iov_base = &cipher[offsets[i]];
+		iov[2 * i].iov_len = offsets[i + 1] - offsets[i];
+		iov[2 * i + 1].iov_base = &newline;
+		iov[2 * i + 1].iov_len = 1;
+		total += iov[2 * i].iov_len + 1;
+	}
+
+	size_t first = 0;
+	while (total > 0)
+	{
+		ssize_t put = ::writev(this->fd, &iov[first], static_cast<int>(iov.size() - first));
+		if (put < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		total -= static_cast<size_t>(put);
+		size_t left = static_cast<size_t>(put);
+		while (first < iov.size() && left >= iov[first].iov_len)
+		{
+			left -= iov[first].iov_len;
+			++first;
+		}
+		if (first < iov.size())
+		{
+			iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+			iov[first].iov_len -= left;
+		}
+	}
+	return !this->sync || ::fdatasync(this->fd) == 0;
+}
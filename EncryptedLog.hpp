@@ -0,0 +1,113 @@
+#ifndef _ENCRYPTEDLOG_HPP_
+#define _ENCRYPTEDLOG_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "BlockKernel.hpp"
+
+/**
+ * An append-only encrypted log with group commit.  Producers on any number of threads push records onto a lock-free
+ * queue and return at once; one writer thread takes whatever has queued up, encrypts the whole group with a single
+ * kernel call and appends it with one writev (plus an optional fdatasync), so the syscall cost is shared by every
+ * record in the group.  A group closes when it reaches the byte limit, MAX_RECORDS records, or the delay after its
+ * first record, whichever comes first.
+ *
+ * On disk every record is its ciphertext, padded to whole blocks, followed by '\n' (the alphabet has no newline), so
+ * the file decrypts with Hill::decryptRecords.
+ */ 
+class EncryptedLog
+{
+public:
+  static const size_t MAX_RECORDS = 512; //records per group; two iovecs each stay within IOV_MAX
+
+  /**
+   * Parameterized constructor.
+   * @param K - the prepared encryption key; it must outlive the log.
+   * @param groupBytes - plaintext bytes at which a group is written without waiting further.
+   * @param delay - microseconds a group may wait for more records after its first one, 0 to write at once.
+   * @param sync - true to fdatasync after every group.
+   */ 
+  EncryptedLog(const BlockKernel &K, size_t groupBytes = 1 << 20, unsigned int delay = 1000, bool sync = false);
+
+  /**
+   * Destructor.  Writes everything still queued and closes the file.
+   */ 
+  ~EncryptedLog();
+
+  EncryptedLog(const EncryptedLog &) = delete;
+  EncryptedLog & operator=(const EncryptedLog &) = delete;
+
+  /**
+   * Opens (or creates) the log for appending and starts the writer.
+   * @param path - the log file.
+   * @return true if open, false if the key is empty, the log is already open or the file cannot be opened.
+   */ 
+  bool open( const std::string & path );
+
+  /**
+   * Queues one record; it does not wait for the write.  It may race with close(): a record it accepts is written
+   * before close() returns.
+   * @param record - the plaintext record.
+   * @return true if queued, false if the log is not open or a write has failed.
+   */ 
+  bool append( const std::string & record );
+
+  /**
+   * Waits until every record appended before the call is written (and synced, if enabled).
+   * @return true if written, false if a write failed.
+   */ 
+  bool flush();
+
+  /**
+   * Writes everything still queued, stops the writer and closes the file.
+   * @return true if every record was written, false otherwise.
+   */ 
+  bool close();
+
+  /**
+   * Returns the number of groups written so far.
+   * @return the group count.
+   */ 
+  uint64_t groups() const;
+
+private:
+  struct Node
+  {
+    std::atomic<Node *> next;
+    std::string text;
+  };
+
+  const BlockKernel &K;
+  size_t groupBytes;
+  unsigned int delay;
+  bool sync;
+  int fd;
+  std::thread writer;
+
+  std::atomic<Node *> head; //producers swap themselves in here
+  Node *tail; //writer-owned stub; the queue is tail->next onwards
+
+  std::atomic<uint64_t> appended; //records pushed
+  uint64_t taken; //records popped by the writer; like appended it carries over a close and reopen
+  std::atomic<uint64_t> written; //records on disk
+  std::atomic<uint64_t> grouped; //groups written
+  std::atomic<bool> sleeping; //writer is waiting for records
+  std::atomic<bool> opened; //append accepts records
+  std::atomic<unsigned int> appending; //appends between their check of opened and the end of their push
+  std::atomic<bool> stopping;
+  std::atomic<bool> failed;
+  std::mutex lock;
+  std::condition_variable wake; //records arrived or stopping
+  std::condition_variable done; //written advanced
+
+  Node * pop();
+  void run();
+  bool write(Node ** group, size_t count);
+};
+#endif
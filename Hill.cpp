@@ -1,4 +1,12 @@
 #include "Hill.hpp"
+#include "Container.hpp"
+#include "PackedFormat.hpp"
+#include "Pipeline.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 /**
    * Default constructor. It should set the encryption key to {2,4,3,5} (2-by-2) and the decryption key to its inverse.
@@ -14,6 +22,9 @@ Hill::Hill() {
 	this->D.set(1, 2);
 	this->D.set(2, 16);
 	this->D.set(3, 28);
+
+	this->EK = BlockKernel(this->E);
+	this->DK = BlockKernel(this->D);
 }
 
 /**
@@ -24,7 +35,7 @@ Hill::Hill() {
 Hill::Hill(const Matrix& K, bool encryption) {
 	if (encryption)
 	{
-		if (this->calculateDeterminant(K))
+		if (this->invertible(K))
 		{
 			setE(K);
 			Matrix inverse = this->inv_mod(this->E);
@@ -41,7 +52,7 @@ Hill::Hill(const Matrix& K, bool encryption) {
 	}
 	else
 	{
-		if (this->calculateDeterminant(K))
+		if (this->invertible(K))
 		{
 			setD(K);
 			Matrix inverse = this->inv_mod(this->D);
@@ -65,7 +76,7 @@ Hill::Hill(const Matrix& K, bool encryption) {
  */
 Hill::Hill(const Matrix& E, const Matrix& D)
 {
-	if (this->calculateDeterminant(E) && this->calculateDeterminant(D) && E.size(1) == D.size(1) && this->inv_mod(E).equal(D))
+	if (this->invertible(E) && this->invertible(D) && E.size(1) == D.size(1) && this->inv_mod(E).equal(D))
 	{
 		setE(E);
 		setD(D);
@@ -136,9 +147,10 @@ Matrix Hill::getD() const {
  */
 bool Hill::setE(const Matrix& E) {
 
-	if (E.size(1) >= 2 && E.size(1) == E.size(2) && calculateDeterminant(E))
+	if (this->invertible(E))
 	{
 		this->E = E;
+		this->EK = BlockKernel(E);
 		return true;
 	}
 	else
@@ -146,6 +158,7 @@ bool Hill::setE(const Matrix& E) {
 		std::vector<int> vec;
 		Matrix result(vec, 0, 0);
 		this->E = result;
+		this->EK = BlockKernel();
 		return false;
 	}
 }
@@ -156,9 +169,10 @@ bool Hill::setE(const Matrix& E) {
  * @return true if set is successful, false otherwise.
  */
 bool Hill::setD(const Matrix& D) {
-	if (D.size(1) >= 2 && D.size(1) == D.size(2) && calculateDeterminant(D))
+	if (this->invertible(D))
 	{
 		this->D = D;
+		this->DK = BlockKernel(D);
 		return true;
 	}
 	else
@@ -166,6 +180,7 @@ bool Hill::setD(const Matrix& D) {
 		std::vector<int> vec;
 		Matrix result(vec, 0, 0);
 		this->D = result;
+		this->DK = BlockKernel();
 		return false;
 	}
 }
@@ -177,21 +192,20 @@ bool Hill::setD(const Matrix& D) {
  */
 std::string Hill::encrypt(const std::string& P)
 {
-	Matrix plain;
-	std::string result = "";
-	plain = this->l2num(P, this->E.size(2));
-
-	if (this->calculateDeterminant(this->E))
-	{
-		Matrix cipher = this->E.mult(plain);
-		result = this->n2let(cipher);
-	}
-	else
-	{
-		result = "";
-	}
-	return result;
+	//EK is only non-empty when setE accepted E
+	return this->transform(P, this->EK);
+}
 
+/**
+ * Encrypt the given plaintext using the previous set encryption key, choosing what happens to characters outside the alphabet.
+ * @param P - the plaintext to encrypt
+ * @param policy - Alphabet::ZERO to encrypt them as 'A' like encrypt(P), Alphabet::REJECT to refuse P
+ * @param rejected - if not null, receives the index of the first rejected character, P.length() if there is none
+ * @return the ciphertext, an empty string if the encryption key is invalid or P was rejected.
+ */
+std::string Hill::encrypt(const std::string& P, Alphabet::Policy policy, size_t* rejected)
+{
+	return this->transform(P, this->EK, policy, rejected);
 }
 
 /**
@@ -204,10 +218,11 @@ std::string Hill::encrypt(const std::string& P, const Matrix& E)
 {
 	Matrix plain;
 	std::string result = "";
-	plain = this->l2num(P, this->E.size(2));
 
-	if (this->calculateDeterminant(E))
+	//the blocks follow the given key, not the stored one; the integer determinant overflows and says nothing mod 29
+	if (this->invertible(E))
 	{
+		plain = this->l2num(P, E.size(2));
 		Matrix cipher = E.mult(plain);
 		result = this->n2let(cipher);
 	}
@@ -225,20 +240,20 @@ std::string Hill::encrypt(const std::string& P, const Matrix& E)
  */
 std::string Hill::decrypt(const std::string& C)
 {
-	Matrix cipher;
-	std::string result = "";
-	cipher = this->l2num(C, this->D.size(2));
+	//DK is only non-empty when setD accepted D
+	return this->transform(C, this->DK);
+}
 
-	if (this->calculateDeterminant(this->D))
-	{
-		Matrix plain = this->D.mult(cipher);
-		result = this->n2let(plain);
-	}
-	else
-	{
-		result = "";
-	}
-	return result;
+/**
+ * Decrypt the given ciphertext using the previous set decryption key, choosing what happens to characters outside the alphabet.
+ * @param C - the ciphertext to decrypt
+ * @param policy - Alphabet::ZERO to decrypt them as 'A' like decrypt(C), Alphabet::REJECT to refuse C
+ * @param rejected - if not null, receives the index of the first rejected character, C.length() if there is none
+ * @return the plaintext, an empty string if the decryption key is invalid or C was rejected.
+ */
+std::string Hill::decrypt(const std::string& C, Alphabet::Policy policy, size_t* rejected)
+{
+	return this->transform(C, this->DK, policy, rejected);
 }
 
 /**
@@ -251,10 +266,11 @@ std::string Hill::decrypt(const std::string& C, const Matrix& D)
 {
 	Matrix cipher;
 	std::string result = "";
-	cipher = this->l2num(C, this->D.size(2));
 
-	if (this->calculateDeterminant(D))
+	//as in encrypt(P, E): D decides validity and block size
+	if (this->invertible(D))
 	{
+		cipher = this->l2num(C, D.size(2));
 		Matrix plain = D.mult(cipher);
 		result = this->n2let(plain);
 	}
@@ -265,15 +281,455 @@ std::string Hill::decrypt(const std::string& C, const Matrix& D)
 	return result;
 }
 
+/**
+ * Encrypt many independent plaintexts at once using the previous set encryption key.
+ * @param P - the plaintexts to encrypt
+ * @param out - arena receiving the ciphertexts back to back (empty if the encryption key is invalid)
+ * @param offsets - receives P.size()+1 entries; ciphertext i is out.substr(offsets[i], offsets[i+1] - offsets[i])
+ */
+void Hill::encryptBatch(const std::vector<std::string>& P, std::string& out, std::vector<size_t>& offsets)
+{
+	this->transformBatch(P, this->EK, out, offsets);
+}
+
+/**
+ * Decrypt many independent ciphertexts at once using the previous set decryption key.
+ * @param C - the ciphertexts to decrypt
+ * @param out - arena receiving the plaintexts back to back (empty if the decryption key is invalid)
+ * @param offsets - receives C.size()+1 entries; plaintext i is out.substr(offsets[i], offsets[i+1] - offsets[i])
+ */
+void Hill::decryptBatch(const std::vector<std::string>& C, std::string& out, std::vector<size_t>& offsets)
+{
+	this->transformBatch(C, this->DK, out, offsets);
+}
+
+/**
+ * Encrypt everything read from in and write the ciphertext to out using the previous set encryption key.
+ * @param in - the plaintext source
+ * @param out - the ciphertext sink
+ * @param chunk - number of characters to process per chunk (rounded up to a whole number of blocks)
+ * @return true if the whole stream was encrypted, false if the encryption key is invalid or a stream failed.
+ */
+bool Hill::encryptStream(std::istream& in, std::ostream& out, size_t chunk)
+{
+	return this->transformStream(in, out, this->EK, chunk);
+}
+
+/**
+ * Decrypt everything read from in and write the plaintext to out using the previous set decryption key.
+ * @param in - the ciphertext source
+ * @param out - the plaintext sink
+ * @param chunk - number of characters to process per chunk (rounded up to a whole number of blocks)
+ * @return true if the whole stream was decrypted, false if the decryption key is invalid or a stream failed.
+ */
+bool Hill::decryptStream(std::istream& in, std::ostream& out, size_t chunk)
+{
+	return this->transformStream(in, out, this->DK, chunk);
+}
+
+/**
+ * Encrypt a whole file using the previous set encryption key.
+ * @param in - path of the plaintext file
+ * @param out - path of the ciphertext file to create (overwritten if it exists)
+ * @return true if the file was encrypted, false if the encryption key is invalid, a file could not be mapped or out is the input file.
+ */
+bool Hill::encryptFile(const std::string& in, const std::string& out)
+{
+	return this->transformFile(in, out, this->EK);
+}
+
+/**
+ * Decrypt a whole file using the previous set decryption key.
+ * @param in - path of the ciphertext file
+ * @param out - path of the plaintext file to create (overwritten if it exists)
+ * @return true if the file was decrypted, false if the decryption key is invalid, a file could not be mapped or out is the input file.
+ */
+bool Hill::decryptFile(const std::string& in, const std::string& out)
+{
+	return this->transformFile(in, out, this->DK);
+}
+
+/**
+ * Encrypt a whole file on several threads using the previous set encryption key.
+ * @param in - path of the plaintext file
+ * @param out - path of the ciphertext file to create (overwritten if it exists)
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @param rate - if not null, receives the throughput in MB/s (input bytes over wall-clock time)
+ * @return true if the file was encrypted, false if the encryption key is invalid, a file could not be mapped or out is the input file.
+ */
+bool Hill::encryptFileParallel(const std::string& in, const std::string& out, unsigned int threads, double* rate)
+{
+	return this->transformFileParallel(in, out, this->EK, threads, rate);
+}
+
+/**
+ * Decrypt a whole file on several threads using the previous set decryption key.
+ * @param in - path of the ciphertext file
+ * @param out - path of the plaintext file to create (overwritten if it exists)
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @param rate - if not null, receives the throughput in MB/s (input bytes over wall-clock time)
+ * @return true if the file was decrypted, false if the decryption key is invalid, a file could not be mapped or out is the input file.
+ */
+bool Hill::decryptFileParallel(const std::string& in, const std::string& out, unsigned int threads, double* rate)
+{
+	return this->transformFileParallel(in, out, this->DK, threads, rate);
+}
+
+/**
+ * Encrypt everything read from a pipe or socket and write the ciphertext to another descriptor using the previous set encryption key.
+ * @param in - descriptor to read the plaintext from, until end of file
+ * @param out - descriptor to write the ciphertext to
+ * @param chunk - bytes per chunk (rounded up to a whole number of blocks)
+ * @param depth - number of chunks in flight
+ * @return true if the whole input was encrypted and written, false if the encryption key is invalid or I/O failed.
+ */
+bool Hill::encryptPipe(int in, int out, size_t chunk, unsigned int depth)
+{
+	Pipeline pipe(this->EK, chunk, depth);
+	return pipe.run(in, out);
+}
+
+/**
+ * Decrypt everything read from a pipe or socket and write the plaintext to another descriptor using the previous set decryption key.
+ * @param in - descriptor to read the ciphertext from, until end of file
+ * @param out - descriptor to write the plaintext to
+ * @param chunk - bytes per chunk (rounded up to a whole number of blocks)
+ * @param depth - number of chunks in flight
+ * @return true if the whole input was decrypted and written, false if the decryption key is invalid or I/O failed.
+ */
+bool Hill::decryptPipe(int in, int out, size_t chunk, unsigned int depth)
+{
+	Pipeline pipe(this->DK, chunk, depth);
+	return pipe.run(in, out);
+}
+
+/**
+ * Decrypt only part of a ciphertext using the previous set decryption key.
+ * @param C - the ciphertext (e.g. a memory-mapped file)
+ * @param size - number of characters in C
+ * @param offset - position of the first plaintext character wanted
+ * @param length - number of plaintext characters wanted
+ * @return decrypt(C).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+ */
+std::string Hill::decryptRange(const char* C, size_t size, size_t offset, size_t length)
+{
+	size_t total = this->DK.padded(size); //length of decrypt(C)
+	if (offset >= total)
+	{
+		return "";
+	}
+	size_t end = (length < total - offset) ? offset + length : total;
+
+	//widen [offset, end) to whole blocks; the last block may run past size, text() pads it like decrypt does
+	unsigned int n = this->DK.size();
+	size_t first = offset / n * n;
+	size_t last = this->DK.padded(end);
+	size_t avail = ((last < size) ? last : size) - first;
+
+	std::string blocks(last - first, ' ');
+	this->DK.text(C + first, avail, &blocks[0]);
+	return blocks.substr(offset - first, end - offset);
+}
+
+/**
+ * Decrypt only part of a ciphertext string using the previous set decryption key.
+ * @param C - the ciphertext
+ * @param offset - position of the first plaintext character wanted
+ * @param length - number of plaintext characters wanted
+ * @return decrypt(C).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+ */
+std::string Hill::decryptRange(const std::string& C, size_t offset, size_t length)
+{
+	return this->decryptRange(C.data(), C.length(), offset, length);
+}
+
+/**
+ * Decrypt only part of a memory-mapped ciphertext file using the previous set decryption key.
+ * @param C - the mapped ciphertext
+ * @param offset - position of the first plaintext character wanted
+ * @param length - number of plaintext characters wanted
+ * @return decrypt(file contents).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+ */
+std::string Hill::decryptRange(const MappedFile& C, size_t offset, size_t length)
+{
+	return this->decryptRange(C.data(), C.size(), offset, length);
+}
+
+/**
+ * Bring a ciphertext up to date after the plaintext was edited, using the previous set encryption key.
+ * @param C - ciphertext of the old plaintext; updated in place to encrypt(P)
+ * @param P - the new plaintext
+ * @param edits - (offset, length) ranges of P whose characters changed, including any characters appended past the old end
+ * @return true if C was updated, false if the encryption key is invalid.
+ */
+bool Hill::reencrypt(std::string& C, const std::string& P, const std::vector<std::pair<size_t, size_t> >& edits)
+{
+	unsigned int n = this->EK.size();
+	if (n == 0)
+	{
+		return false;
+	}
+	C.resize(this->EK.padded(P.length()), ' ');
+	if (P.empty())
+	{
+		return true;
+	}
+
+	//the last block is always redone: it carries the padding, which moves whenever the length changes
+	std::vector<std::pair<size_t, size_t> > ranges(edits);
+	ranges.push_back(std::make_pair(P.length() - 1, 1));
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		size_t offset = ranges[i].first;
+		if (offset >= P.length() || ranges[i].second == 0)
+		{
+			continue;
+		}
+		//widen to whole blocks; only a block at the very end of P may stay partial and be padded
+		size_t end = (ranges[i].second < P.length() - offset) ? offset + ranges[i].second : P.length();
+		size_t first = offset / n * n;
+		size_t last = this->EK.padded(end);
+		this->EK.text(P.data() + first, ((last < P.length()) ? last : P.length()) - first, &C[first]);
+	}
+	return true;
+}
+
+/**
+ * Encrypt delimiter-separated records using the previous set encryption key.
+ * @param P - the records, e.g. newline-delimited text
+ * @param size - number of characters in P
+ * @param delimiter - the record separator
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return the encrypted records with their delimiters, an empty string if the encryption key or the delimiter is invalid.
+ */
+std::string Hill::encryptRecords(const char* P, size_t size, char delimiter, unsigned int threads)
+{
+	return this->transformRecords(P, size, this->EK, delimiter, threads);
+}
+
+/**
+ * Encrypt delimiter-separated records held in a string.
+ * @param P - the records, e.g. newline-delimited text
+ * @param delimiter - the record separator
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return the encrypted records with their delimiters, an empty string if the encryption key or the delimiter is invalid.
+ */
+std::string Hill::encryptRecords(const std::string& P, char delimiter, unsigned int threads)
+{
+	return this->transformRecords(P.data(), P.length(), this->EK, delimiter, threads);
+}
+
+/**
+ * Decrypt delimiter-separated records using the previous set decryption key.
+ * @param C - the encrypted records
+ * @param size - number of characters in C
+ * @param delimiter - the record separator
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return the decrypted records with their delimiters, an empty string if the decryption key or the delimiter is invalid.
+ */
+std::string Hill::decryptRecords(const char* C, size_t size, char delimiter, unsigned int threads)
+{
+	return this->transformRecords(C, size, this->DK, delimiter, threads);
+}
+
+/**
+ * Decrypt delimiter-separated records held in a string.
+ * @param C - the encrypted records
+ * @param delimiter - the record separator
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return the decrypted records with their delimiters, an empty string if the decryption key or the delimiter is invalid.
+ */
+std::string Hill::decryptRecords(const std::string& C, char delimiter, unsigned int threads)
+{
+	return this->transformRecords(C.data(), C.length(), this->DK, delimiter, threads);
+}
+
+/**
+ * Encrypt the given plaintext using the previous set encryption key and return it in the compact binary format.
+ * @param P - the plaintext to encrypt
+ * @return the packed ciphertext, an empty string if the encryption key is invalid or larger than PackedFormat::MAX_BLOCK.
+ */
+std::string Hill::encryptPacked(const std::string& P)
+{
+	if (this->EK.size() == 0 || this->EK.size() > PackedFormat::MAX_BLOCK)
+	{
+		return "";
+	}
+	std::vector<uint8_t> sym(this->EK.padded(P.length()));
+	if (!sym.empty())
+	{
+		this->EK.textToSymbols(P.data(), P.length(), &sym[0]);
+	}
+	return PackedFormat::encode(sym.empty() ? nullptr : &sym[0], sym.size(), this->EK.size(), P.length());
+}
+
+/**
+ * Decrypt a packed ciphertext produced by encryptPacked using the previous set decryption key.
+ * @param C - the packed ciphertext
+ * @return the plaintext, an empty string if the decryption key is invalid, C is malformed or its block size does not match D.
+ */
+std::string Hill::decryptPacked(const std::string& C)
+{
+	unsigned int n;
+	uint64_t length;
+	std::vector<uint8_t> sym;
+	if (this->DK.size() == 0 || !PackedFormat::decode(C, n, length, sym) || n != this->DK.size())
+	{
+		return "";
+	}
+	std::string result(sym.size(), ' ');
+	if (!sym.empty())
+	{
+		this->DK.symbolsToText(&sym[0], sym.size(), &result[0]);
+	}
+	result.resize(length);
+	return result;
+}
+
+/**
+ * Encrypt a whole file into an indexed Container using the previous set encryption key.
+ * @param in - path of the plaintext file
+ * @param out - path of the container file to create (overwritten if it exists)
+ * @param segment - plaintext characters per segment (rounded up to a whole number of blocks)
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return true if the container was written, false if the encryption key is invalid or larger than Container::MAX_BLOCK, a file could not be mapped or out is the input file.
+ */
+bool Hill::encryptContainer(const std::string& in, const std::string& out, size_t segment, unsigned int threads)
+{
+	MappedFile src;
+	if (this->EK.size() == 0 || !src.openRead(in) || src.sameFile(out))
+	{
+		return false;
+	}
+	return Container::write(out, src.data(), src.size(), this->EK, segment, threads);
+}
+
+/**
+ * Decrypt a Container file back to the original plaintext file using the previous set decryption key.
+ * @param in - path of the container file
+ * @param out - path of the plaintext file to create (overwritten if it exists)
+ * @param threads - number of worker threads, 0 for one per hardware thread
+ * @return true if the file was decrypted, false if the key is invalid or does not match, the index is malformed, a checksum fails, a file could not be mapped or out is the input file.
+ */
+bool Hill::decryptContainer(const std::string& in, const std::string& out, unsigned int threads)
+{
+	Container src;
+	MappedFile dst;
+	if (this->DK.size() == 0 || !src.open(in) || src.blockSize() != this->DK.size() || src.sameFile(out) || !dst.create(out, src.length()))
+	{
+		return false;
+	}
+	return src.length() == 0 || src.decrypt(this->DK, dst.writableData(), threads);
+}
+
 /**
  * Mount a known-plaintext attack against the Hill cipher assuming an n-by-n encryption matrix.  Set E/D to the encryption/decryption key if they can be recovered.
  * @param P - the plaintexts that correspond to C
  * @param C - the ciphertexts that correspond to P
- * @return true if the encryption and decryption keys have been recovered.
+ * @param n - the size of the encryption matrix
+ * @return true if the encryption and decryption keys have been recovered, false if the blocks do not reach rank n or no n-by-n key explains every pair.
  */
 bool Hill::kpa(const std::vector<std::string>& P, const std::vector<std::string>& C, unsigned int n)
 {
-	return true;
+	if (n < 2 || P.size() != C.size())
+	{
+		return false;
+	}
+	const uint8_t* symbol = Alphabet::symbols();
+
+	//greedy basis of the plaintext blocks mod 29: an accepted block is reduced against the earlier ones and scaled so its
+	//first non-zero symbol (its pivot) is 1, so a new block is independent exactly when something survives the reduction
+	std::vector<std::vector<int> > basis;
+	std::vector<unsigned int> pivots;
+	std::vector<int> plain; //accepted plaintext blocks, column-wise
+	std::vector<int> cipher; //their ciphertext blocks, column-wise
+	std::vector<int> block(n);
+	std::vector<int> r(n);
+	for (size_t i = 0; i < P.size() && basis.size() < n; ++i)
+	{
+		//a block counts if the ciphertext holds all n of its symbols; the plaintext is padded with '.' like l2num
+		size_t blocks = std::min((P[i].length() + n - 1) / n, C[i].length() / n);
+		for (size_t b = 0; b < blocks && basis.size() < n; ++b)
+		{
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				size_t at = b * n + k;
+				block[k] = (at < P[i].length()) ? symbol[static_cast<unsigned char>(P[i][at])] : 26;
+				r[k] = block[k];
+			}
+			for (size_t j = 0; j < basis.size(); ++j)
+			{
+				int f = r[pivots[j]];
+				if (f)
+				{
+					for (unsigned int k = 0; k < n; ++k)
+					{
+						r[k] = (r[k] + (29 - f) * basis[j][k]) % 29;
+					}
+				}
+			}
+			unsigned int pivot = 0;
+			while (pivot < n && r[pivot] == 0)
+			{
+				++pivot;
+			}
+			if (pivot == n)
+			{
+				continue;
+			}
+			int scale = this->ZI29[r[pivot] - 1];
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				r[k] = r[k] * scale % 29;
+			}
+			basis.push_back(r);
+			pivots.push_back(pivot);
+			plain.insert(plain.end(), block.begin(), block.end());
+			for (unsigned int k = 0; k < n; ++k)
+			{
+				cipher.push_back(symbol[static_cast<unsigned char>(C[i][b * n + k])]);
+			}
+		}
+	}
+	if (basis.size() < n)
+	{
+		return false;
+	}
+
+	//E * plain = cipher, and plain is invertible by construction
+	Matrix key = Matrix(cipher, n, n).mult(this->inv_mod(Matrix(plain, n, n)));
+	for (unsigned int i = 0; i < n * n; ++i)
+	{
+		key.set(i, mod(key.get(i), 29));
+	}
+	Matrix inverse = this->inv_mod(key);
+	if (inverse.size(1) != n)
+	{
+		return false;
+	}
+
+	//the key must explain every pair, not only the n blocks it was solved from
+	BlockKernel K(key);
+	std::vector<uint8_t> sym;
+	for (size_t i = 0; i < P.size(); ++i)
+	{
+		size_t blocks = std::min((P[i].length() + n - 1) / n, C[i].length() / n);
+		if (blocks == 0)
+		{
+			continue;
+		}
+		size_t length = std::min(P[i].length(), blocks * n);
+		sym.resize(K.padded(length));
+		K.textToSymbols(P[i].data(), length, &sym[0]);
+		for (size_t k = 0; k < blocks * n; ++k)
+		{
+			if (sym[k] != symbol[static_cast<unsigned char>(C[i][k])])
+			{
+				return false;
+			}
+		}
+	}
+	return this->setE(key) && this->setD(inverse);
 }
 
 int Hill::calculateDeterminant(const Matrix A)
@@ -372,13 +828,13 @@ Matrix Hill::l2num(const std::string& s, unsigned int n)
 			numRow = divide + 1;
 		}
 
-		Matrix res(std::vector<int>(n), n, numRow);
+		Matrix res(std::vector<int>(n * numRow), n, numRow);
 
 		for (int i = 0; i < s.length(); ++i)
 		{
 			if (isalpha(s[i]))
 			{
-				int num = s[i] - 'A';
+				int num = toupper(s[i]) - 'A';
 				res.set(i, num);
 			}
 			else
@@ -443,6 +899,248 @@ std::string Hill::n2let(const Matrix& A)
 	return result;
 }
 
+std::string Hill::transform(const std::string& s, const BlockKernel& K, Alphabet::Policy policy, size_t* rejected)
+{
+	unsigned int n = K.size();
+	if (rejected)
+	{
+		*rejected = s.length();
+	}
+	if (n == 0 || s.empty())
+	{
+		return "";
+	}
+
+	//single fused pass: the only allocation is the returned string
+	std::string result(K.padded(s.length()), ' ');
+	size_t done = K.text(s.data(), s.length(), &result[0], policy);
+	if (done < s.length())
+	{
+		if (rejected)
+		{
+			*rejected = done;
+		}
+		return "";
+	}
+	return result;
+}
+
+void Hill::transformBatch(const std::vector<std::string>& s, const BlockKernel& K, std::string& out, std::vector<size_t>& offsets)
+{
+	unsigned int n = K.size();
+	offsets.assign(s.size() + 1, 0);
+	if (n == 0)
+	{
+		out.clear();
+		return;
+	}
+
+	//every message is padded to whole blocks on its own, so the arena is just the blocks of all messages in order
+	for (size_t m = 0; m < s.size(); ++m)
+	{
+		offsets[m + 1] = offsets[m] + (s[m].length() + n - 1) / n * n;
+	}
+	out.resize(offsets.back());
+
+	//slabs of SLAB blocks keep the interleaved planes in cache while the messages stream through
+	const size_t SLAB = 4096;
+	std::vector<uint8_t> planes(n * SLAB);
+	size_t total = offsets.back() / n;
+	size_t m = 0; //message feeding the next block
+	size_t pos = 0; //next character of s[m]
+	for (size_t base = 0; base < total; base += SLAB)
+	{
+		size_t count = (total - base < SLAB) ? total - base : SLAB;
+		for (size_t b = 0; b < count; ++b)
+		{
+			while (pos >= s[m].length())
+			{
+				++m;
+				pos = 0;
+			}
+			const std::string& msg = s[m];
+			for (unsigned int i = 0; i < n; ++i, ++pos)
+			{
+				planes[i * SLAB + b] = (pos < msg.length()) ? Alphabet::symbol(msg[pos]) : 26;
+			}
+		}
+
+		K.transform(&planes[0], &planes[0], count, SLAB);
+
+		char* dst = &out[base * n];
+		for (size_t b = 0; b < count; ++b)
+		{
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				*dst++ = Alphabet::letter(planes[i * SLAB + b]);
+			}
+		}
+	}
+}
+
+bool Hill::transformStream(std::istream& in, std::ostream& out, const BlockKernel& K, size_t chunk)
+{
+	if (K.size() == 0)
+	{
+		return false;
+	}
+	chunk = K.padded(chunk ? chunk : 1);
+
+	//chunk is a whole number of blocks, so a full read never splits a block; read only comes back short at the true
+	//end of the stream, which is the one place the partial last block gets padded (padded(have) <= chunk, in place)
+	std::vector<char> buf(chunk);
+	bool more = true;
+	while (more)
+	{
+		in.read(&buf[0], chunk);
+		size_t have = static_cast<size_t>(in.gcount());
+		if (in.bad())
+		{
+			return false;
+		}
+		more = static_cast<bool>(in);
+
+		size_t len = K.padded(have);
+		K.text(&buf[0], have, &buf[0]);
+		out.write(&buf[0], len);
+		if (!out)
+		{
+			return false;
+		}
+	}
+	out.flush();
+	return static_cast<bool>(out);
+}
+
+bool Hill::transformFile(const std::string& in, const std::string& out, const BlockKernel& K)
+{
+	if (K.size() == 0)
+	{
+		return false;
+	}
+	MappedFile src;
+	MappedFile dst;
+	//out must not be in itself (or a hard link to it): creating it would truncate the mapped input
+	if (!src.openRead(in) || src.sameFile(out) || !dst.create(out, K.padded(src.size())))
+	{
+		return false;
+	}
+	K.text(src.data(), src.size(), dst.writableData());
+	return true;
+}
+
+bool Hill::transformFileParallel(const std::string& in, const std::string& out, const BlockKernel& K, unsigned int threads, double* rate)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (K.size() == 0)
+	{
+		return false;
+	}
+	MappedFile src;
+	MappedFile dst;
+	if (!src.openRead(in) || src.sameFile(out) || !dst.create(out, K.padded(src.size())))
+	{
+		return false;
+	}
+
+	//chunks are whole blocks, so only the last one can end in a partial block and get padded
+	const size_t chunk = K.padded(4 << 20);
+	const char* from = src.data();
+	char* to = dst.writableData();
+	size_t total = src.size();
+	{
+		ThreadPool pool(threads);
+		for (size_t off = 0; off < total; off += chunk)
+		{
+			size_t len = (total - off < chunk) ? total - off : chunk;
+			pool.submit([&K, from, to, off, len]() { K.text(from + off, len, to + off); });
+		}
+		pool.wait();
+	}
+
+	if (rate)
+	{
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		*rate = (seconds > 0) ? total / seconds / 1e6 : 0;
+	}
+	return true;
+}
+
+std::string Hill::transformRecords(const char* s, size_t size, const BlockKernel& K, char delimiter, unsigned int threads)
+{
+	//a delimiter from the alphabet would also turn up inside the ciphertext of a record
+	if (K.size() == 0 || size == 0 || Alphabet::contains(delimiter))
+	{
+		return "";
+	}
+
+	//cut roughly every CHUNK bytes, then move each cut forward past the next delimiter so no record is split
+	const size_t CHUNK = 1 << 20;
+	std::vector<size_t> cuts(1, 0);
+	while (cuts.back() < size)
+	{
+		size_t at = cuts.back() + CHUNK;
+		if (at >= size)
+		{
+			cuts.push_back(size);
+			break;
+		}
+		const char* d = static_cast<const char*>(std::memchr(s + at, delimiter, size - at));
+		cuts.push_back(d ? static_cast<size_t>(d - s) + 1 : size);
+	}
+	size_t chunks = cuts.size() - 1;
+
+	//pass 1: output size of every chunk (each record grows to whole blocks, delimiters stay), then prefix sums
+	std::vector<size_t> offsets(chunks + 1, 0);
+	ThreadPool pool(threads);
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		pool.submit([&, c]() {
+			size_t total = 0;
+			const char* p = s + cuts[c];
+			const char* end = s + cuts[c + 1];
+			while (p < end)
+			{
+				const char* d = static_cast<const char*>(std::memchr(p, delimiter, end - p));
+				const char* stop = d ? d : end;
+				total += K.padded(stop - p) + (d ? 1 : 0);
+				p = d ? d + 1 : end;
+			}
+			offsets[c + 1] = total;
+		});
+	}
+	pool.wait();
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		offsets[c + 1] += offsets[c];
+	}
+
+	//pass 2: every chunk writes its records at its own offset
+	std::string out(offsets.back(), ' ');
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		pool.submit([&, c]() {
+			char* dst = &out[0] + offsets[c];
+			const char* p = s + cuts[c];
+			const char* end = s + cuts[c + 1];
+			while (p < end)
+			{
+				const char* d = static_cast<const char*>(std::memchr(p, delimiter, end - p));
+				const char* stop = d ? d : end;
+				K.text(p, stop - p, dst);
+				dst += K.padded(stop - p);
+				if (d)
+				{
+					*dst++ = delimiter;
+				}
+				p = d ? d + 1 : end;
+			}
+		});
+	}
+	pool.wait();
+	return out;
+}
+
 Matrix Hill::Identity_creation(unsigned int n)
 {
 	std::vector<int> vec;
@@ -480,75 +1178,68 @@ Matrix Hill::Echelon_Form(Matrix A, Matrix I)
 
 }
 
+bool Hill::invertible(const Matrix& K)
+{
+	return K.size(1) >= 2 && K.size(1) == K.size(2) && this->inv_mod(K).size(1) == K.size(1);
+}
+
 //Calculate the matrix inversion of A, mod 29
+//Gauss-Jordan elimination on [A | I] over Z_{29}; A is invertible mod 29 exactly when every column yields a non-zero pivot
 Matrix Hill::inv_mod(Matrix A) {
-	
-	if (this->calculateDeterminant(A))
+	unsigned int n = A.size(1);
+	std::vector<int> empty;
+	if (n == 0 || n != A.size(2))
 	{
-		Matrix I = this->Identity_creation(A.size(1));
-		Matrix Echelon = this->Echelon_Form(A, I);
-		std::vector<int> temp;
-		for (int i = 0; i < Echelon.size(1); ++i)
-		{
-			// switch row if (i,i) is zero
-			if (Echelon.get(i, i) == 0)
-			{
-				temp.clear();
-				for (int j = i + 1; j < Echelon.size(1); ++j)
-				{
-					if (Echelon.get(j, i) != 0)
-					{
-						for (int a = 0; a < Echelon.size(2); a++)
-						{
-							temp.push_back(Echelon.get(j, a));
-						}
-						for (int a = 0; a < Echelon.size(2); a++)
-						{
-							Echelon.set(j, a, Echelon.get(i, a));
-						}
-						for (int a = 0; a < Echelon.size(2); a++)
-						{
-							Echelon.set(i, a, temp[a]);
-						}
-						break;
-					}
-				}
-			}
-			this->row_mult(Echelon, i, 0, Echelon.size(2)-1, ZI29[Echelon.get(i,i)-1] );
+		return Matrix(empty, 0, 0);
+	}
 
-			if (i + 1 < Echelon.size(1))
-			{
-				for (int a = 0; a <= i; ++a)
-				{
-					this->row_diff(Echelon, i + 1, 0, Echelon.size(2) - 1, Echelon, i, Echelon.get(i + 1, a));
-				}
-			}
+	Matrix I = this->Identity_creation(n);
+	Matrix Echelon = this->Echelon_Form(A, I);
+	for (unsigned int i = 0; i < n * n; ++i)
+	{
+		Echelon.set(i, mod(Echelon.get(i), 29));
+	}
+
+	for (unsigned int col = 0; col < n; ++col)
+	{
+		// find a row at or below col with a non-zero entry and swap it into place
+		unsigned int pivot = col;
+		while (pivot < n && Echelon.get(pivot, col) == 0)
+		{
+			++pivot;
+		}
+		if (pivot == n) //an empty matrix is returned if A is not invertible
+		{
+			return Matrix(empty, 0, 0);
 		}
-		
-		int counter = 0;
-		for (int i = Echelon.size(1) - 2; i >= 0; --i)
+		if (pivot != col)
 		{
-			for (int j = Echelon.size(1) - 1 - counter; j<Echelon.size(1); ++j)
+			for (unsigned int a = 0; a < 2 * n; ++a)
 			{
-				this->row_diff(Echelon, i, 0, Echelon.size(2)-1, Echelon, j, Echelon.get(i,j));
+				int temp = Echelon.get(col, a);
+				Echelon.set(col, a, Echelon.get(pivot, a));
+				Echelon.set(pivot, a, temp);
 			}
-			counter++;
 		}
+		this->row_mult(Echelon, col, 0, 2 * n - 1, ZI29[Echelon.get(col, col) - 1]);
 
-		std::vector<int> vec;
-		for (int i = A.size(1)*A.size(2); i < Echelon.size(1)*Echelon.size(2); ++i)
+		// clear the column above and below the pivot
+		for (unsigned int i = 0; i < n; ++i)
 		{
-			vec.push_back(Echelon.get(i));
+			if (i != col && Echelon.get(i, col) != 0)
+			{
+				this->row_diff(Echelon, i, 0, 2 * n - 1, Echelon, col, Echelon.get(i, col));
+			}
 		}
-		Matrix res(vec, A.size(1), A.size(2));
-		return res;
 	}
-	else //an empty matrix is returned if A is not invertible
+
+	std::vector<int> vec;
+	for (unsigned int i = n * n; i < 2 * n * n; ++i)
 	{
-		std::vector<int> vec;
-		Matrix result(vec, 0, 0);
-		return result;
+		vec.push_back(Echelon.get(i));
 	}
+	Matrix res(vec, n, n);
+	return res;
 }
 
 //calculate c = a mod b, where c = [0,b)
@@ -562,7 +1253,7 @@ unsigned int Hill::mod(int a, int b) {
 	{
 		int process = a - (2 * a);
 		int sub = process % b;
-		x = b - sub;
+		x = (b - sub) % b;
 	}
 	
 	return x;
@@ -3,9 +3,13 @@
 
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "Matrix.hpp"
+#include "Alphabet.hpp"
+#include "BlockKernel.hpp"
+#include "MappedFile.hpp"
 
 /**
  * A C++ class to perform encryption/decryption and cryptanalysis using/of the Hill cipher with a 29 character alphabet.
@@ -65,6 +69,15 @@ public:
    */ 
   std::string encrypt( const std::string & P );
 
+  /**
+   * Encrypt the given plaintext using the previous set encryption key, choosing what happens to characters outside the alphabet.
+   * @param P - the plaintext to encrypt
+   * @param policy - Alphabet::ZERO to encrypt them as 'A' like encrypt(P), Alphabet::REJECT to refuse P
+   * @param rejected - if not null, receives the index of the first rejected character, P.length() if there is none
+   * @return the ciphertext, an empty string if the encryption key is invalid or P was rejected.
+   */ 
+  std::string encrypt( const std::string & P, Alphabet::Policy policy, size_t * rejected = nullptr );
+
   /**
    * Encrypt the given plaintext using the given encryption key, an empty string if the encryption key is invalid.
    * @param P - the plaintext to encrypt
@@ -80,6 +93,15 @@ public:
    */ 
   std::string decrypt( const std::string & C );
 
+  /**
+   * Decrypt the given ciphertext using the previous set decryption key, choosing what happens to characters outside the alphabet.
+   * @param C - the ciphertext to decrypt
+   * @param policy - Alphabet::ZERO to decrypt them as 'A' like decrypt(C), Alphabet::REJECT to refuse C
+   * @param rejected - if not null, receives the index of the first rejected character, C.length() if there is none
+   * @return the plaintext, an empty string if the decryption key is invalid or C was rejected.
+   */ 
+  std::string decrypt( const std::string & C, Alphabet::Policy policy, size_t * rejected = nullptr );
+
   /**
    * Decrypt the given ciphertext using the given decryption key, an empty string if the decryption key is invalid.
    * @param C - the plaintext to encrypt
@@ -88,11 +110,234 @@ public:
    */ 
   std::string decrypt( const std::string & C, const Matrix & D);
 
+  /**
+   * Encrypt many independent plaintexts at once using the previous set encryption key.  All blocks of all messages are
+   * transposed into one interleaved layout so the vector kernel runs full width even for short messages; each message is
+   * padded on its own exactly like encrypt.
+   * @param P - the plaintexts to encrypt
+   * @param out - arena receiving the ciphertexts back to back (empty if the encryption key is invalid)
+   * @param offsets - receives P.size()+1 entries; ciphertext i is out.substr(offsets[i], offsets[i+1] - offsets[i])
+   */ 
+  void encryptBatch( const std::vector<std::string> & P, std::string & out, std::vector<size_t> & offsets );
+
+  /**
+   * Decrypt many independent ciphertexts at once using the previous set decryption key; the counterpart of encryptBatch.
+   * @param C - the ciphertexts to decrypt
+   * @param out - arena receiving the plaintexts back to back (empty if the decryption key is invalid)
+   * @param offsets - receives C.size()+1 entries; plaintext i is out.substr(offsets[i], offsets[i+1] - offsets[i])
+   */ 
+  void decryptBatch( const std::vector<std::string> & C, std::string & out, std::vector<size_t> & offsets );
+
+  /**
+   * Encrypt everything read from in and write the ciphertext to out using the previous set encryption key.  The input is
+   * processed in fixed-size chunks and partial blocks are carried across chunk boundaries, so memory use is bounded by
+   * the chunk size; '.' padding is only applied at the true end of the stream.  The output equals encrypt(whole input).
+   * @param in - the plaintext source
+   * @param out - the ciphertext sink
+   * @param chunk - number of characters to process per chunk (rounded up to a whole number of blocks)
+   * @return true if the whole stream was encrypted, false if the encryption key is invalid or a stream failed.
+   */ 
+  bool encryptStream( std::istream & in, std::ostream & out, size_t chunk = 1 << 20 );
+
+  /**
+   * Decrypt everything read from in and write the plaintext to out using the previous set decryption key; the
+   * counterpart of encryptStream.
+   * @param in - the ciphertext source
+   * @param out - the plaintext sink
+   * @param chunk - number of characters to process per chunk (rounded up to a whole number of blocks)
+   * @return true if the whole stream was decrypted, false if the decryption key is invalid or a stream failed.
+   */ 
+  bool decryptStream( std::istream & in, std::ostream & out, size_t chunk = 1 << 20 );
+
+  /**
+   * Encrypt a whole file using the previous set encryption key.  The input is memory-mapped read-only, the output is
+   * created at its final size and mapped writable, and the block kernel runs directly between the two mappings.
+   * @param in - path of the plaintext file
+   * @param out - path of the ciphertext file to create (overwritten if it exists)
+   * @return true if the file was encrypted, false if the encryption key is invalid, a file could not be mapped or out is the input file.
+   */ 
+  bool encryptFile( const std::string & in, const std::string & out );
+
+  /**
+   * Decrypt a whole file using the previous set decryption key; the counterpart of encryptFile.
+   * @param in - path of the ciphertext file
+   * @param out - path of the plaintext file to create (overwritten if it exists)
+   * @return true if the file was decrypted, false if the decryption key is invalid, a file could not be mapped or out is the input file.
+   */ 
+  bool decryptFile( const std::string & in, const std::string & out );
+
+  /**
+   * Encrypt a whole file on several threads using the previous set encryption key.  The mapped input is split on
+   * block-aligned boundaries, the chunks run on a thread pool and each one is written at its original offset, so the
+   * output is byte-identical to encryptFile.
+   * @param in - path of the plaintext file
+   * @param out - path of the ciphertext file to create (overwritten if it exists)
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @param rate - if not null, receives the throughput in MB/s (input bytes over wall-clock time)
+   * @return true if the file was encrypted, false if the encryption key is invalid, a file could not be mapped or out is the input file.
+   */ 
+  bool encryptFileParallel( const std::string & in, const std::string & out, unsigned int threads = 0, double * rate = nullptr );
+
+  /**
+   * Decrypt a whole file on several threads using the previous set decryption key; the counterpart of encryptFileParallel.
+   * @param in - path of the ciphertext file
+   * @param out - path of the plaintext file to create (overwritten if it exists)
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @param rate - if not null, receives the throughput in MB/s (input bytes over wall-clock time)
+   * @return true if the file was decrypted, false if the decryption key is invalid, a file could not be mapped or out is the input file.
+   */ 
+  bool decryptFileParallel( const std::string & in, const std::string & out, unsigned int threads = 0, double * rate = nullptr );
+
+  /**
+   * Encrypt everything read from a pipe or socket and write the ciphertext to another descriptor using the previous set
+   * encryption key.  Reading, encrypting and writing run on three threads connected by lock-free rings of recycled
+   * chunks, so the CPU keeps working while I/O is in flight and memory stays at depth chunks.
+   * @param in - descriptor to read the plaintext from, until end of file
+   * @param out - descriptor to write the ciphertext to
+   * @param chunk - bytes per chunk (rounded up to a whole number of blocks)
+   * @param depth - number of chunks in flight
+   * @return true if the whole input was encrypted and written, false if the encryption key is invalid or I/O failed.
+   */ 
+  bool encryptPipe( int in, int out, size_t chunk = 1 << 20, unsigned int depth = 4 );
+
+  /**
+   * Decrypt everything read from a pipe or socket and write the plaintext to another descriptor using the previous set
+   * decryption key; the counterpart of encryptPipe.
+   * @param in - descriptor to read the ciphertext from, until end of file
+   * @param out - descriptor to write the plaintext to
+   * @param chunk - bytes per chunk (rounded up to a whole number of blocks)
+   * @param depth - number of chunks in flight
+   * @return true if the whole input was decrypted and written, false if the decryption key is invalid or I/O failed.
+   */ 
+  bool decryptPipe( int in, int out, size_t chunk = 1 << 20, unsigned int depth = 4 );
+
+  /**
+   * Decrypt only part of a ciphertext using the previous set decryption key.  The request is widened to block
+   * boundaries, only the covered blocks are decrypted and the result is trimmed, so the cost depends on length and
+   * not on the size of the ciphertext.
+   * @param C - the ciphertext (e.g. a memory-mapped file)
+   * @param size - number of characters in C
+   * @param offset - position of the first plaintext character wanted
+   * @param length - number of plaintext characters wanted
+   * @return decrypt(C).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+   */ 
+  std::string decryptRange( const char * C, size_t size, size_t offset, size_t length );
+
+  /**
+   * Decrypt only part of a ciphertext string using the previous set decryption key.
+   * @param C - the ciphertext
+   * @param offset - position of the first plaintext character wanted
+   * @param length - number of plaintext characters wanted
+   * @return decrypt(C).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+   */ 
+  std::string decryptRange( const std::string & C, size_t offset, size_t length );
+
+  /**
+   * Decrypt only part of a memory-mapped ciphertext file using the previous set decryption key.
+   * @param C - the mapped ciphertext
+   * @param offset - position of the first plaintext character wanted
+   * @param length - number of plaintext characters wanted
+   * @return decrypt(file contents).substr(offset, length), an empty string if the decryption key is invalid or offset is past the end.
+   */ 
+  std::string decryptRange( const MappedFile & C, size_t offset, size_t length );
+
+  /**
+   * Bring a ciphertext up to date after the plaintext was edited, using the previous set encryption key.  Only the blocks
+   * overlapping the edits are re-encrypted, plus the last block so that its '.' padding follows a change in length.
+   * @param C - ciphertext of the old plaintext; updated in place to encrypt(P)
+   * @param P - the new plaintext
+   * @param edits - (offset, length) ranges of P whose characters changed, including any characters appended past the old end
+   * @return true if C was updated, false if the encryption key is invalid.
+   */ 
+  bool reencrypt( std::string & C, const std::string & P, const std::vector<std::pair<size_t, size_t> > & edits );
+
+  /**
+   * Encrypt delimiter-separated records using the previous set encryption key.  Delimiters are copied through unchanged
+   * and every record is encrypted (and padded) on its own, exactly like one encrypt call per record.  The input is cut
+   * into chunks at record boundaries (found with memchr) and the chunks run in parallel.  Ciphertext uses every character
+   * of the alphabet, so a delimiter from it (letters, '.', '?', ' ') is refused: decryptRecords could not find the records.
+   * @param P - the records, e.g. newline-delimited text
+   * @param size - number of characters in P
+   * @param delimiter - the record separator
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return the encrypted records with their delimiters, an empty string if the encryption key or the delimiter is invalid.
+   */ 
+  std::string encryptRecords( const char * P, size_t size, char delimiter = '\n', unsigned int threads = 0 );
+
+  /**
+   * Encrypt delimiter-separated records held in a string; see the buffer overload.
+   * @param P - the records, e.g. newline-delimited text
+   * @param delimiter - the record separator
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return the encrypted records with their delimiters, an empty string if the encryption key or the delimiter is invalid.
+   */ 
+  std::string encryptRecords( const std::string & P, char delimiter = '\n', unsigned int threads = 0 );
+
+  /**
+   * Decrypt delimiter-separated records using the previous set decryption key; the counterpart of encryptRecords.
+   * @param C - the encrypted records
+   * @param size - number of characters in C
+   * @param delimiter - the record separator
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return the decrypted records with their delimiters, an empty string if the decryption key or the delimiter is invalid.
+   */ 
+  std::string decryptRecords( const char * C, size_t size, char delimiter = '\n', unsigned int threads = 0 );
+
+  /**
+   * Decrypt delimiter-separated records held in a string; see the buffer overload.
+   * @param C - the encrypted records
+   * @param delimiter - the record separator
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return the decrypted records with their delimiters, an empty string if the decryption key or the delimiter is invalid.
+   */ 
+  std::string decryptRecords( const std::string & C, char delimiter = '\n', unsigned int threads = 0 );
+
+  /**
+   * Encrypt the given plaintext using the previous set encryption key and return it in the compact binary format of
+   * PackedFormat (13 base-29 symbols per 64-bit word plus a 16-byte header with block size and original length).
+   * @param P - the plaintext to encrypt
+   * @return the packed ciphertext, an empty string if the encryption key is invalid or larger than
+   *         PackedFormat::MAX_BLOCK.
+   */ 
+  std::string encryptPacked( const std::string & P );
+
+  /**
+   * Decrypt a packed ciphertext produced by encryptPacked using the previous set decryption key.  The symbols are
+   * unpacked straight into the block kernel and the '.' padding is cut off using the stored original length.
+   * @param C - the packed ciphertext
+   * @return the plaintext, an empty string if the decryption key is invalid, C is malformed or its block size does not match D.
+   */ 
+  std::string decryptPacked( const std::string & C );
+
+  /**
+   * Encrypt a whole file into an indexed Container using the previous set encryption key: independently decodable
+   * segments followed by a footer index of offsets, lengths and checksums, for parallel and random-access decoding.
+   * @param in - path of the plaintext file
+   * @param out - path of the container file to create (overwritten if it exists)
+   * @param segment - plaintext characters per segment (rounded up to a whole number of blocks)
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return true if the container was written, false if the encryption key is invalid or larger than Container::MAX_BLOCK, a file could not be mapped or out is the input file.
+   */ 
+  bool encryptContainer( const std::string & in, const std::string & out, size_t segment = 1 << 20, unsigned int threads = 0 );
+
+  /**
+   * Decrypt a Container file back to the original plaintext file using the previous set decryption key; segments are
+   * verified and decrypted in parallel straight into the mapped output.
+   * @param in - path of the container file
+   * @param out - path of the plaintext file to create (overwritten if it exists)
+   * @param threads - number of worker threads, 0 for one per hardware thread
+   * @return true if the file was decrypted, false if the key is invalid or does not match, the index is malformed, a checksum fails, a file could not be mapped or out is the input file.
+   */ 
+  bool decryptContainer( const std::string & in, const std::string & out, unsigned int threads = 0 );
+
   /**
    * Mount a known-plaintext attack against the Hill cipher assuming an n-by-n encryption matrix.  Set E/D to the encryption/decryption key if they can be recovered.
+   * Pairs are cut into n-symbol blocks like l2num; n linearly independent plaintext blocks are picked by elimination mod 29,
+   * E is solved from them and must then reproduce every pair.  The keys are left unchanged if the attack fails.
    * @param P - the plaintexts that correspond to C
    * @param C - the ciphertexts that correspond to P 
-   * @return true if the encryption and decryption keys have been recovered.
+   * @param n - the size of the encryption matrix
+   * @return true if the encryption and decryption keys have been recovered, false if the blocks do not reach rank n or no n-by-n key explains every pair.
    */ 
   bool kpa( const std::vector<std::string> & P, const std::vector<std::string> & C, unsigned int n);
 
@@ -105,6 +350,8 @@ public:
 private:
   Matrix D; //current decryption key; must be consistent with E
   Matrix E; //current encryption key; must be consistent with D
+  BlockKernel DK; //D prepared for the vectorized block transform, empty if D is not set
+  BlockKernel EK; //E prepared for the vectorized block transform, empty if E is not set
   //multiplicative inverses over Z_{29}; e.g., ZI29[1] = 15 is multiplicative inverse of 2. 
   const std::vector<int> ZI29 = {1,15,10,22,6,5,25,11,13,3,8,17,9,27,2,20,12,21,26,16,18,4,24,23,7,19,14,28};
 
@@ -115,6 +362,24 @@ private:
   //convert the matrix to a string of characters using our 29 character alphabet
   std::string n2let(const Matrix & A);
 
+  //same result as n2let(K.mult(l2num(s, n))) but through the interleaved block kernel instead of Matrix objects
+  std::string transform(const std::string & s, const BlockKernel & K, Alphabet::Policy policy = Alphabet::ZERO, size_t * rejected = nullptr);
+
+  //structure-of-arrays transform of many messages into one arena, see encryptBatch
+  void transformBatch(const std::vector<std::string> & s, const BlockKernel & K, std::string & out, std::vector<size_t> & offsets);
+
+  //chunked stream transform with O(chunk) memory, see encryptStream
+  bool transformStream(std::istream & in, std::ostream & out, const BlockKernel & K, size_t chunk);
+
+  //mmap-to-mmap file transform, see encryptFile
+  bool transformFile(const std::string & in, const std::string & out, const BlockKernel & K);
+
+  //block-aligned chunks of an mmap-to-mmap transform spread over a thread pool, see encryptFileParallel
+  bool transformFileParallel(const std::string & in, const std::string & out, const BlockKernel & K, unsigned int threads, double * rate);
+
+  //per-record transform with delimiters passed through, chunks cut at record boundaries and run in parallel, see encryptRecords
+  std::string transformRecords(const char * s, size_t size, const BlockKernel & K, char delimiter, unsigned int threads);
+
   //Calculate the matrix inversion of A, mod 29
   
   //an empty matrix is returned if A is not invertible
@@ -140,5 +405,8 @@ private:
 
   Matrix Echelon_Form(Matrix A, Matrix I);
 
+  //true if K is a square key of size >= 2 with an inverse mod 29; the integer determinant overflows for large keys
+  bool invertible(const Matrix & K);
+
 };
 #endif
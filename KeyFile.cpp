@@ -0,0 +1,80 @@
+#include "KeyFile.hpp"
+#include "Hill.hpp"
+#include "MappedFile.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+bool KeyFile::read(const std::string& path, Matrix& K)
+{
+	MappedFile f;
+	if (!f.openRead(path))
+	{
+		return false;
+	}
+	std::string text(f.data() ? f.data() : "", f.size());
+	std::vector<long> rows;
+	const char* p = text.c_str();
+	char* end;
+	for (long v = std::strtol(p, &end, 10); end != p; v = std::strtol(p, &end, 10))
+	{
+		rows.push_back(v);
+		p = end;
+	}
+	unsigned int n = static_cast<unsigned int>(std::lround(std::sqrt(static_cast<double>(rows.size()))));
+	if (n < 2 || n * n != rows.size())
+	{
+		return false;
+	}
+
+	//Matrix takes its values column-wise
+	std::vector<int> cols(rows.size());
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		for (unsigned int j = 0; j < n; ++j)
+		{
+			cols[j * n + i] = static_cast<int>(rows[i * n + j]);
+		}
+	}
+	K = Matrix(cols, n, n);
+	return true;
+}
+
+std::string KeyFile::format(const Matrix& K)
+{
+	std::string s;
+	for (unsigned int i = 0; i < K.size(1); ++i)
+	{
+		for (unsigned int j = 0; j < K.size(2); ++j)
+		{
+			if (j)
+			{
+				s += ' ';
+			}
+			s += std::to_string(K.get(i, j));
+		}
+		s += '\n';
+	}
+	return s;
+}
+
+Matrix KeyFile::random(unsigned int n, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> symbol(0, 28);
+	for (;;)
+	{
+		std::vector<int> vec(n * n);
+		for (size_t i = 0; i < vec.size(); ++i)
+		{
+			vec[i] = symbol(rng);
+		}
+		Hill H(Matrix(vec, n, n), true);
+		if (H.getE().size(1) == n && H.getD().size(1) == n)
+		{
+			return H.getE();
+		}
+	}
+}
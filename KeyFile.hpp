@@ -0,0 +1,38 @@
+#ifndef _KEYFILE_HPP_
+#define _KEYFILE_HPP_
+
+#include <string>
+
+#include "Matrix.hpp"
+
+/**
+ * Key matrices for the command-line tools: reading and writing key files (n lines of n whitespace-separated integers,
+ * row by row) and drawing random keys.
+ */ 
+class KeyFile
+{
+public:
+  /**
+   * Reads a key file.
+   * @param path - the file to read.
+   * @param K - receives the key; it is not modified on failure.
+   * @return true if the file holds a square matrix of at least 2x2, false otherwise.
+   */ 
+  static bool read( const std::string & path, Matrix & K );
+
+  /**
+   * Formats a key the way read expects it.
+   * @param K - the key to format.
+   * @return one line per row, entries separated by single spaces.
+   */ 
+  static std::string format( const Matrix & K );
+
+  /**
+   * Draws random matrices until one is invertible mod 29 and accepted by Hill as an encryption key.
+   * @param n - block size, at least 2.
+   * @param seed - seed for the generator, so a key can be reproduced.
+   * @return an n-by-n key.
+   */ 
+  static Matrix random( unsigned int n, unsigned int seed );
+};
+#endif
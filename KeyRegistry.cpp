@@ -0,0 +1,361 @@
+#include "KeyRegistry.hpp"
+#include "Alphabet.hpp"
+#include "Hill.hpp"
+
+#include <cstring>
+
+namespace
+{
+	const size_t CHUNK = 64 << 10; //arena chunk size in bytes
+
+	//splitmix64 finalizer: consecutive tenant ids spread over all shards and buckets
+	uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return x;
+	}
+
+	//one block at a time from the compact matrix; the last block is padded with '.' like Hill::l2num
+	std::string apply(const uint8_t* K, unsigned int n, const std::string& s)
+	{
+		std::string out((s.length() + n - 1) / n * n, ' ');
+		const uint8_t* table = Alphabet::symbols();
+		std::vector<uint8_t> block(n);
+		for (size_t base = 0; base < out.length(); base += n)
+		{
+			for (unsigned int j = 0; j < n; ++j)
+			{
+				block[j] = (base + j < s.length()) ? table[static_cast<unsigned char>(s[base + j])] : 26;
+			}
+			for (unsigned int i = 0; i < n; ++i)
+			{
+				uint32_t sum = 0;
+				for (unsigned int j = 0; j < n; ++j)
+				{
+					sum += K[i * n + j] * block[j];
+				}
+				out[base + i] = Alphabet::letter(static_cast<uint8_t>(sum % 29));
+			}
+		}
+		return out;
+	}
+}
+
+const uint8_t* KeyRegistry::Key::E() const
+{
+	return reinterpret_cast<const uint8_t*>(this) + sizeof(Key);
+}
+
+const uint8_t* KeyRegistry::Key::D() const
+{
+	return this->E() + this->n * this->n;
+}
+
+std::string KeyRegistry::Key::encrypt(const std::string& P) const
+{
+	return apply(this->E(), this->n, P);
+}
+
+std::string KeyRegistry::Key::decrypt(const std::string& C) const
+{
+	return apply(this->D(), this->n, C);
+}
+
+Matrix KeyRegistry::Key::encryption() const
+{
+	std::vector<int> cols(this->n * this->n);
+	for (unsigned int i = 0; i < this->n; ++i)
+	{
+		for (unsigned int j = 0; j < this->n; ++j)
+		{
+			cols[j * this->n + i] = this->E()[i * this->n + j];
+		}
+	}
+	return Matrix(cols, this->n, this->n);
+}
+
+KeyRegistry::Table::Table(size_t capacity)
+	: mask(capacity - 1), entries(new Entry[capacity])
+{
+	for (size_t i = 0; i < capacity; ++i)
+	{
+		this->entries[i].tenant.store(NO_TENANT, std::memory_order_relaxed);
+		this->entries[i].key.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+KeyRegistry::KeyRegistry(unsigned int shards)
+{
+	unsigned int bits = 0;
+	while ((1u << bits) < shards && bits < 16)
+	{
+		++bits;
+	}
+	this->shift = 64 - bits;
+	for (unsigned int i = 0; i < (1u << bits); ++i)
+	{
+		Shard* s = new Shard;
+		s->used = 0;
+		s->live = 0;
+		s->arenaUsed = CHUNK;
+		s->arenaBytes = 0;
+		s->tables.push_back(std::unique_ptr<Table>(new Table(16)));
+		s->table.store(s->tables.back().get(), std::memory_order_release);
+		this->shards.push_back(std::unique_ptr<Shard>(s));
+	}
+}
+
+KeyRegistry::~KeyRegistry()
+{
+}
+
+void KeyRegistry::reserve(size_t tenants)
+{
+	size_t perShard = tenants / this->shards.size() + 1;
+	size_t capacity = 16;
+	while (capacity * 3 / 4 < perShard)
+	{
+		capacity *= 2;
+	}
+	for (size_t i = 0; i < this->shards.size(); ++i)
+	{
+		Shard& s = *this->shards[i];
+		std::lock_guard<std::mutex> guard(s.writer);
+		if (s.table.load(std::memory_order_relaxed)->mask + 1 < capacity)
+		{
+			this->grow(s, capacity);
+		}
+	}
+}
+
+bool KeyRegistry::set(uint64_t tenant, const Matrix& E)
+{
+	unsigned int n = E.size(1);
+	if (tenant == NO_TENANT || n < 2 || n > 255 || n != E.size(2))
+	{
+		return false;
+	}
+	//the same mod-29 Gauss-Jordan inverse as Hill; an empty matrix means E is not invertible
+	Hill H;
+	Matrix inverse = H.inv_mod(E);
+	if (inverse.size(1) != n)
+	{
+		return false;
+	}
+	std::vector<uint8_t> e(n * n);
+	std::vector<uint8_t> d(n * n);
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		for (unsigned int j = 0; j < n; ++j)
+		{
+			int v = E.get(i, j) % 29;
+			e[i * n + j] = static_cast<uint8_t>(v < 0 ? v + 29 : v);
+			d[i * n + j] = static_cast<uint8_t>(inverse.get(i, j));
+		}
+	}
+
+	uint64_t h = mix(tenant);
+	Shard& s = this->shard(h);
+	std::lock_guard<std::mutex> guard(s.writer);
+	const Key* key = this->store(s, &e[0], &d[0], n);
+	Table* t = s.table.load(std::memory_order_relaxed);
+	if ((s.used + 1) * 4 > (t->mask + 1) * 3)
+	{
+		//removed tenants count towards used but are dropped by the rehash, so the table only doubles for live ones
+		size_t capacity = t->mask + 1;
+		this->grow(s, (s.live + 1) * 2 > capacity ? capacity * 2 : capacity);
+		t = s.table.load(std::memory_order_relaxed);
+	}
+	for (size_t i = h & t->mask; ; i = (i + 1) & t->mask)
+	{
+		Entry& entry = t->entries[i];
+		uint64_t id = entry.tenant.load(std::memory_order_relaxed);
+		if (id == tenant)
+		{
+			const Key* old = entry.key.exchange(key, std::memory_order_release);
+			if (old)
+			{
+				s.retired.push_back(old);
+			}
+			else
+			{
+				++s.live;
+			}
+			return true;
+		}
+		if (id == NO_TENANT)
+		{
+			//the key is in place before the id becomes visible to readers
+			entry.key.store(key, std::memory_order_relaxed);
+			entry.tenant.store(tenant, std::memory_order_release);
+			++s.used;
+			++s.live;
+			return true;
+		}
+	}
+}
+
+const KeyRegistry::Key* KeyRegistry::find(uint64_t tenant) const
+{
+	uint64_t h = mix(tenant);
+	const Table* t = this->shard(h).table.load(std::memory_order_acquire);
+	for (size_t i = h & t->mask; ; i = (i + 1) & t->mask)
+	{
+		uint64_t id = t->entries[i].tenant.load(std::memory_order_acquire);
+		if (id == tenant)
+		{
+			return t->entries[i].key.load(std::memory_order_acquire);
+		}
+		if (id == NO_TENANT)
+		{
+			return nullptr;
+		}
+	}
+}
+
+bool KeyRegistry::remove(uint64_t tenant)
+{
+	uint64_t h = mix(tenant);
+	Shard& s = this->shard(h);
+	std::lock_guard<std::mutex> guard(s.writer);
+	Table* t = s.table.load(std::memory_order_relaxed);
+	for (size_t i = h & t->mask; ; i = (i + 1) & t->mask)
+	{
+		uint64_t id = t->entries[i].tenant.load(std::memory_order_relaxed);
+		if (id == NO_TENANT)
+		{
+			return false;
+		}
+		if (id == tenant)
+		{
+			//the entry keeps its id so probe chains through it stay intact; the key stays in the arena until reclaim()
+			const Key* old = t->entries[i].key.exchange(nullptr, std::memory_order_release);
+			if (old)
+			{
+				s.retired.push_back(old);
+				--s.live;
+			}
+			return old != nullptr;
+		}
+	}
+}
+
+void KeyRegistry::reclaim()
+{
+	for (size_t i = 0; i < this->shards.size(); ++i)
+	{
+		Shard& s = *this->shards[i];
+		std::lock_guard<std::mutex> guard(s.writer);
+		for (size_t k = 0; k < s.retired.size(); ++k)
+		{
+			unsigned int n = s.retired[k]->n;
+			if (s.spare.size() <= n)
+			{
+				s.spare.resize(n + 1);
+			}
+			s.spare[n].push_back(const_cast<Key*>(s.retired[k]));
+		}
+		s.retired.clear();
+		//no lookup is inside an outgrown table any more either; the current table is always the last one
+		s.tables.erase(s.tables.begin(), s.tables.end() - 1);
+	}
+}
+
+size_t KeyRegistry::size() const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < this->shards.size(); ++i)
+	{
+		std::lock_guard<std::mutex> guard(this->shards[i]->writer);
+		total += this->shards[i]->live;
+	}
+	return total;
+}
+
+size_t KeyRegistry::memory() const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < this->shards.size(); ++i)
+	{
+		Shard& s = *this->shards[i];
+		std::lock_guard<std::mutex> guard(s.writer);
+		for (size_t t = 0; t < s.tables.size(); ++t)
+		{
+			total += (s.tables[t]->mask + 1) * sizeof(Entry);
+		}
+		total += s.arenaBytes;
+	}
+	return total;
+}
+
+//Private section
+KeyRegistry::Shard& KeyRegistry::shard(uint64_t hash) const
+{
+	return *this->shards[this->shift == 64 ? 0 : hash >> this->shift];
+}
+
+//keys are bump-allocated from fixed chunks, so they never move once readers can see them; a reclaimed key of the
+//same size is reused first
+const KeyRegistry::Key* KeyRegistry::store(Shard& s, const uint8_t* E, const uint8_t* D, unsigned int n)
+{
+	char* p;
+	if (n < s.spare.size() && !s.spare[n].empty())
+	{
+		p = reinterpret_cast<char*>(s.spare[n].back());
+		s.spare[n].pop_back();
+	}
+	else
+	{
+		size_t bytes = (sizeof(Key) + 2 * n * n + 3) & ~static_cast<size_t>(3);
+		if (s.arenaUsed + bytes > CHUNK)
+		{
+			size_t size = bytes > CHUNK ? bytes : CHUNK;
+			s.arena.push_back(std::unique_ptr<char[]>(new char[size]));
+			s.arenaUsed = 0;
+			s.arenaBytes += size;
+		}
+		p = s.arena.back().get() + s.arenaUsed;
+		s.arenaUsed += bytes;
+	}
+	Key* key = reinterpret_cast<Key*>(p);
+	key->n = static_cast<uint8_t>(n);
+	std::memset(key->reserved, 0, sizeof(key->reserved));
+	std::memcpy(p + sizeof(Key), E, n * n);
+	std::memcpy(p + sizeof(Key) + n * n, D, n * n);
+	return key;
+}
+
+//removed tenants are dropped while rehashing; the old table stays readable for lookups already inside it until
+//reclaim()
+void KeyRegistry::grow(Shard& s, size_t capacity)
+{
+	const Table* old = s.table.load(std::memory_order_relaxed);
+	Table* t = new Table(capacity);
+	size_t used = 0;
+	for (size_t i = 0; i <= old->mask; ++i)
+	{
+		uint64_t id = old->entries[i].tenant.load(std::memory_order_relaxed);
+		const Key* key = old->entries[i].key.load(std::memory_order_relaxed);
+		if (id == NO_TENANT || !key)
+		{
+			continue;
+		}
+		for (size_t j = mix(id) & t->mask; ; j = (j + 1) & t->mask)
+		{
+			if (t->entries[j].tenant.load(std::memory_order_relaxed) == NO_TENANT)
+			{
+				t->entries[j].key.store(key, std::memory_order_relaxed);
+				t->entries[j].tenant.store(id, std::memory_order_relaxed);
+				++used;
+				break;
+			}
+		}
+	}
+	s.used = used;
+	s.tables.push_back(std::unique_ptr<Table>(t));
+	s.table.store(t, std::memory_order_release);
+}
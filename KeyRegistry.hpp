@@ -0,0 +1,167 @@
+#ifndef _KEYREGISTRY_HPP_
+#define _KEYREGISTRY_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Matrix.hpp"
+
+/**
+ * Keys for many tenants, looked up by a 64-bit tenant id.  The id hashes to one of a fixed number of shards; each
+ * shard is an open-addressing table that readers probe without locks, while writers to the same shard take its mutex.
+ * Keys are stored compactly (n and both matrices as bytes, 4 + 2n^2 bytes) in an append-only arena and never move, so
+ * the pointer returned by find() stays valid even after the tenant's key is replaced or removed.  The price is that
+ * every replacement takes new arena space: a registry whose keys rotate grows without bound unless reclaim() is called
+ * now and then, at a point where no reader still uses an old pointer, so later keys can reuse the replaced ones.
+ * Removed tenants keep their table entry until the next rehash, which sizes the new table for the live tenants only;
+ * outgrown tables stay readable until reclaim() frees them.
+ */ 
+class KeyRegistry
+{
+public:
+  /**
+   * A prepared key in compact form: a 4-byte header followed by the encryption and decryption matrices as bytes, row
+   * by row (E then D, n*n bytes each).
+   */ 
+  struct Key
+  {
+    uint8_t n;
+    uint8_t reserved[3];
+
+    /**
+     * Returns the encryption matrix, row by row.
+     * @return n*n entries in [0,29).
+     */ 
+    const uint8_t * E() const;
+
+    /**
+     * Returns the decryption matrix, row by row.
+     * @return n*n entries in [0,29).
+     */ 
+    const uint8_t * D() const;
+
+    /**
+     * Encrypts like Hill::encrypt, straight from the compact matrix.
+     * @param P - the plaintext.
+     * @return the ciphertext, padded with '.' to whole blocks.
+     */ 
+    std::string encrypt( const std::string & P ) const;
+
+    /**
+     * Decrypts like Hill::decrypt, straight from the compact matrix.
+     * @param C - the ciphertext.
+     * @return the plaintext, padded with '.' to whole blocks.
+     */ 
+    std::string decrypt( const std::string & C ) const;
+
+    /**
+     * Expands the encryption key, e.g. to build a BlockKernel for long texts.
+     * @return the encryption key as a Matrix.
+     */ 
+    Matrix encryption() const;
+  };
+
+  static const uint64_t NO_TENANT = ~0ULL; //the one id that cannot be registered
+
+  /**
+   * Parameterized constructor.
+   * @param shards - number of shards, rounded up to a power of two; more shards mean less writer contention.
+   */ 
+  explicit KeyRegistry(unsigned int shards = 64);
+
+  /**
+   * Destructor.  Frees every key; pointers from find() become invalid.
+   */ 
+  ~KeyRegistry();
+
+  KeyRegistry(const KeyRegistry &) = delete;
+  KeyRegistry & operator=(const KeyRegistry &) = delete;
+
+  /**
+   * Sizes the shards for a number of tenants, so filling the registry does not have to grow them.
+   * @param tenants - the expected number of tenants.
+   */ 
+  void reserve( size_t tenants );
+
+  /**
+   * Registers or replaces a tenant's key; the decryption key is derived from E.
+   * @param tenant - the tenant id, anything but NO_TENANT.
+   * @param E - the encryption key.
+   * @return true if stored, false if E is not an invertible key or the id is NO_TENANT.
+   */ 
+  bool set( uint64_t tenant, const Matrix & E );
+
+  /**
+   * Looks a tenant up without taking a lock.
+   * @param tenant - the tenant id.
+   * @return the tenant's key, nullptr if it has none.
+   */ 
+  const Key * find( uint64_t tenant ) const;
+
+  /**
+   * Removes a tenant's key; readers holding the old pointer can keep using it until reclaim().
+   * @param tenant - the tenant id.
+   * @return true if the tenant had a key, false otherwise.
+   */ 
+  bool remove( uint64_t tenant );
+
+  /**
+   * Lets later set() calls reuse the memory of every key replaced or removed so far and frees outgrown tables.
+   * Pointers to those keys become invalid, so call it only while no reader holds one or is inside find(), e.g.
+   * between batches of requests.
+   */ 
+  void reclaim();
+
+  /**
+   * Returns the number of tenants with a key.
+   * @return the count.
+   */ 
+  size_t size() const;
+
+  /**
+   * Returns the memory held by tables and key arenas.
+   * @return bytes allocated.
+   */ 
+  size_t memory() const;
+
+private:
+  struct Entry
+  {
+    std::atomic<uint64_t> tenant; //NO_TENANT if the entry was never used
+    std::atomic<const Key *> key; //nullptr once removed
+  };
+
+  struct Table
+  {
+    size_t mask; //capacity - 1
+    std::unique_ptr<Entry[]> entries;
+    explicit Table(size_t capacity);
+  };
+
+  struct Shard
+  {
+    std::atomic<Table *> table;
+    std::mutex writer;
+    size_t used; //entries with a tenant, removed ones included
+    size_t live; //entries with a key
+    std::vector<std::unique_ptr<Table> > tables; //outgrown tables, then the current one
+    std::vector<std::unique_ptr<char[]> > arena; //chunks holding the keys
+    size_t arenaUsed; //bytes taken from the last chunk
+    size_t arenaBytes; //bytes allocated for all chunks
+    std::vector<const Key *> retired; //keys replaced or removed since the last reclaim()
+    std::vector<std::vector<Key *> > spare; //spare[n] holds reclaimed keys of size n, ready for reuse
+  };
+
+  std::vector<std::unique_ptr<Shard> > shards;
+  unsigned int shift; //64 - log2(shard count)
+
+  Shard & shard(uint64_t hash) const;
+  const Key * store(Shard & s, const uint8_t * E, const uint8_t * D, unsigned int n);
+  void grow(Shard & s, size_t capacity);
+};
+#endif
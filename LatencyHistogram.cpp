@@ -0,0 +1,121 @@
+#include "LatencyHistogram.hpp"
+
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+	: buckets(LINEAR + SHIFTS * SUB, 0)
+{
+	this->total = 0;
+	this->smallest = 0;
+	this->largest = 0;
+	this->sum = 0;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+	++this->buckets[index(ns)];
+	if (this->total == 0 || ns < this->smallest)
+	{
+		this->smallest = ns;
+	}
+	if (ns > this->largest)
+	{
+		this->largest = ns;
+	}
+	++this->total;
+	this->sum += static_cast<double>(ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	if (other.total == 0)
+	{
+		return;
+	}
+	for (size_t i = 0; i < this->buckets.size(); ++i)
+	{
+		this->buckets[i] += other.buckets[i];
+	}
+	if (this->total == 0 || other.smallest < this->smallest)
+	{
+		this->smallest = other.smallest;
+	}
+	if (other.largest > this->largest)
+	{
+		this->largest = other.largest;
+	}
+	this->total += other.total;
+	this->sum += other.sum;
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return this->total;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+	if (this->total == 0)
+	{
+		return 0;
+	}
+	uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * this->total));
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < this->buckets.size(); ++i)
+	{
+		seen += this->buckets[i];
+		if (seen >= rank)
+		{
+			//report the top of the bucket, but never beyond what was actually recorded
+			uint64_t top = (i + 1 < this->buckets.size()) ? value(i + 1) - 1 : this->largest;
+			return top < this->largest ? top : this->largest;
+		}
+	}
+	return this->largest;
+}
+
+uint64_t LatencyHistogram::min() const
+{
+	return this->smallest;
+}
+
+uint64_t LatencyHistogram::max() const
+{
+	return this->largest;
+}
+
+double LatencyHistogram::mean() const
+{
+	return this->total ? this->sum / this->total : 0;
+}
+
+//Private section
+//above LINEAR, the top 7 significant bits of ns pick the bucket: 6 after the leading one, shifted by the exponent
+size_t LatencyHistogram::index(uint64_t ns)
+{
+	if (ns < LINEAR)
+	{
+		return static_cast<size_t>(ns);
+	}
+	unsigned int msb = 63 - __builtin_clzll(ns);
+	unsigned int shift = msb - 6;
+	if (shift > SHIFTS)
+	{
+		return LINEAR + SHIFTS * SUB - 1;
+	}
+	return LINEAR + (shift - 1) * SUB + static_cast<size_t>((ns >> shift) - SUB);
+}
+
+uint64_t LatencyHistogram::value(size_t i)
+{
+	if (i < LINEAR)
+	{
+		return i;
+	}
+	size_t shift = (i - LINEAR) / SUB + 1;
+	return static_cast<uint64_t>(SUB + (i - LINEAR) % SUB) << shift;
+}
@@ -0,0 +1,78 @@
+#ifndef _LATENCYHISTOGRAM_HPP_
+#define _LATENCYHISTOGRAM_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A log-linear histogram of latencies in nanoseconds: exact below 128, and 64 equal buckets per power of two above, so
+ * every recorded value is kept to within 1.6% over the whole range up to about 18 minutes.  Recording is one array
+ * increment; histograms from several threads are merged afterwards.
+ */ 
+class LatencyHistogram
+{
+public:
+  /**
+   * Default constructor.  It creates an empty histogram.
+   */ 
+  LatencyHistogram();
+
+  /**
+   * Records one value.
+   * @param ns - the latency in nanoseconds; larger values than the range are clamped.
+   */ 
+  void record( uint64_t ns );
+
+  /**
+   * Adds all values of another histogram.
+   * @param other - the histogram to add.
+   */ 
+  void merge( const LatencyHistogram & other );
+
+  /**
+   * Returns the number of recorded values.
+   * @return the count.
+   */ 
+  uint64_t count() const;
+
+  /**
+   * Returns a percentile.
+   * @param p - the percentile in [0,100].
+   * @return the smallest bucket value that at least p percent of the values do not exceed, 0 if empty.
+   */ 
+  uint64_t percentile( double p ) const;
+
+  /**
+   * Returns the smallest recorded value.
+   * @return the minimum, 0 if empty.
+   */ 
+  uint64_t min() const;
+
+  /**
+   * Returns the largest recorded value.
+   * @return the maximum, 0 if empty.
+   */ 
+  uint64_t max() const;
+
+  /**
+   * Returns the mean of the recorded values.
+   * @return the exact mean, 0 if empty.
+   */ 
+  double mean() const;
+
+private:
+  static const unsigned int LINEAR = 128; //values below are their own bucket
+  static const unsigned int SUB = 64; //buckets per power of two above LINEAR
+  static const unsigned int SHIFTS = 34; //powers of two above LINEAR
+
+  std::vector<uint64_t> buckets;
+  uint64_t total;
+  uint64_t smallest;
+  uint64_t largest;
+  double sum;
+
+  static size_t index(uint64_t ns);
+  static uint64_t value(size_t i);
+};
+#endif
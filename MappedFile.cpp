@@ -0,0 +1,122 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+{
+	this->fd = -1;
+	this->base = nullptr;
+	this->length = 0;
+	this->writable = false;
+}
+
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+bool MappedFile::openRead(const std::string& path)
+{
+	this->close();
+	this->fd = ::open(path.c_str(), O_RDONLY);
+	if (this->fd < 0)
+	{
+		return false;
+	}
+	//st_size means nothing for pipes and devices, which would map as empty files
+	struct stat st;
+	if (fstat(this->fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		this->close();
+		return false;
+	}
+	this->length = static_cast<size_t>(st.st_size);
+	this->writable = false;
+	return this->map(PROT_READ);
+}
+
+bool MappedFile::create(const std::string& path, size_t size)
+{
+	this->close();
+	this->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (this->fd < 0)
+	{
+		return false;
+	}
+	if (ftruncate(this->fd, static_cast<off_t>(size)) != 0)
+	{
+		this->close();
+		return false;
+	}
+	this->length = size;
+	this->writable = true;
+	return this->map(PROT_READ | PROT_WRITE);
+}
+
+void MappedFile::close()
+{
+	if (this->base)
+	{
+		munmap(this->base, this->length);
+		this->base = nullptr;
+	}
+	if (this->fd >= 0)
+	{
+		::close(this->fd);
+		this->fd = -1;
+	}
+	this->length = 0;
+	this->writable = false;
+}
+
+const char* MappedFile::data() const
+{
+	return this->base;
+}
+
+char* MappedFile::writableData()
+{
+	return this->writable ? this->base : nullptr;
+}
+
+size_t MappedFile::size() const
+{
+	return this->length;
+}
+
+bool MappedFile::sameFile(const std::string& path) const
+{
+	struct stat mine;
+	struct stat other;
+	if (this->fd < 0 || fstat(this->fd, &mine) != 0 || ::stat(path.c_str(), &other) != 0)
+	{
+		return false;
+	}
+	return mine.st_dev == other.st_dev && mine.st_ino == other.st_ino;
+}
+
+//Private section
+bool MappedFile::map(int prot)
+{
+	//mmap rejects zero-length mappings; an empty file is simply left unmapped
+	if (this->length == 0)
+	{
+		return true;
+	}
+	void* p = mmap(nullptr, this->length, prot, MAP_SHARED, this->fd, 0);
+	if (p == MAP_FAILED)
+	{
+		this->close();
+		return false;
+	}
+	this->base = static_cast<char*>(p);
+	//hints only: failures (e.g. no transparent huge pages for this filesystem) are ignored
+	madvise(this->base, this->length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(this->base, this->length, MADV_HUGEPAGE);
+#endif
+	return true;
+}
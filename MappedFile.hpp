@@ -0,0 +1,84 @@
+#ifndef _MAPPEDFILE_HPP_
+#define _MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A memory-mapped file (POSIX mmap).  Input files are mapped read-only; output files are created at their final size
+ * with ftruncate and mapped writable, so the block kernel can run directly between two mappings without any copies.
+ * The mapping is released when the object is closed or destroyed.
+ */ 
+class MappedFile
+{
+public:
+  /**
+   * Default constructor. It creates an unmapped object (size() == 0, data() == nullptr).
+   */ 
+  MappedFile();
+
+  /**
+   * Destructor.  Unmaps the file and closes its descriptor.
+   */ 
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  /**
+   * Maps an existing file read-only and advises the kernel that it will be read sequentially.
+   * @param path - the file to map.
+   * @return true if the file is mapped (an empty file maps to size() == 0), false if it cannot be opened or is not a
+   *         regular file (a pipe, device or directory).
+   */ 
+  bool openRead( const std::string & path );
+
+  /**
+   * Creates (or truncates) a file, sizes it with ftruncate and maps it writable.
+   * @param path - the file to create.
+   * @param size - the final size of the file in bytes.
+   * @return true if the file is created and mapped, false otherwise.
+   */ 
+  bool create( const std::string & path, size_t size );
+
+  /**
+   * Unmaps the file and closes its descriptor; safe to call on an unmapped object.
+   */ 
+  void close();
+
+  /**
+   * Returns the start of the mapping.
+   * @return a pointer to the first byte, nullptr if nothing (or an empty file) is mapped.
+   */ 
+  const char * data() const;
+
+  /**
+   * Returns the start of a writable mapping.
+   * @return a pointer to the first byte, nullptr if nothing (or an empty file) is mapped or the mapping is read-only.
+   */ 
+  char * writableData();
+
+  /**
+   * Returns the size of the mapping.
+   * @return the number of mapped bytes.
+   */ 
+  size_t size() const;
+
+  /**
+   * Tells whether a path names the mapped file itself (same device and inode), e.g. through a hard link.  Creating
+   * that path would truncate the file under the mapping, so callers must not write an output there.
+   * @param path - the path to compare.
+   * @return true if path is the mapped file, false if it is another file, does not exist or nothing is mapped.
+   */ 
+  bool sameFile( const std::string & path ) const;
+
+private:
+  int fd; //file descriptor, -1 if closed
+  char *base; //start of the mapping, nullptr if unmapped
+  size_t length; //number of mapped bytes
+  bool writable; //true if mapped with PROT_WRITE
+
+  //map length bytes of fd with the given protection and apply the sequential/huge page hints
+  bool map(int prot);
+};
+#endif
@@ -0,0 +1,184 @@
+#include "PackedFormat.hpp"
+
+namespace
+{
+	const char MAGIC[4] = { 'H', '2', '9', 'P' };
+	const unsigned char VERSION = 1;
+	const uint64_t WORD_LIMIT = 10260628712958602189ULL; //29^13, the first word that does not unpack to symbols below 29
+
+	void put64(unsigned char* p, uint64_t v)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			p[i] = static_cast<unsigned char>(v >> (8 * i));
+		}
+	}
+
+	uint64_t get64(const unsigned char* p)
+	{
+		uint64_t v = 0;
+		for (int i = 7; i >= 0; --i)
+		{
+			v = (v << 8) | p[i];
+		}
+		return v;
+	}
+
+	//one word from 13 symbols, Horner from the most significant digit
+	inline uint64_t join(const uint8_t* s)
+	{
+		uint64_t w = s[12];
+		for (int j = 11; j >= 0; --j)
+		{
+			w = w * 29 + s[j];
+		}
+		return w;
+	}
+
+	//13 symbols from one word; division by the constant 29 compiles to a multiply-high
+	inline void split(uint64_t w, uint8_t* s)
+	{
+		for (int j = 0; j < 13; ++j)
+		{
+			uint64_t q = w / 29;
+			s[j] = static_cast<uint8_t>(w - q * 29);
+			w = q;
+		}
+	}
+}
+
+/*
+ * Words are independent, so both loops run four of them side by side: the four dependency chains overlap in the
+ * multiplier pipeline (and give the compiler straight-line lanes to vectorize where the target has 64-bit multiplies).
+ */
+void PackedFormat::pack(const uint8_t* sym, size_t count, uint64_t* words)
+{
+	size_t full = count / SYMBOLS_PER_WORD;
+	size_t w = 0;
+	for (; w + 4 <= full; w += 4)
+	{
+		const uint8_t* s = sym + w * SYMBOLS_PER_WORD;
+		uint64_t a = join(s);
+		uint64_t b = join(s + 13);
+		uint64_t c = join(s + 26);
+		uint64_t d = join(s + 39);
+		words[w] = a;
+		words[w + 1] = b;
+		words[w + 2] = c;
+		words[w + 3] = d;
+	}
+	for (; w < full; ++w)
+	{
+		words[w] = join(sym + w * SYMBOLS_PER_WORD);
+	}
+	if (full * SYMBOLS_PER_WORD < count)
+	{
+		uint8_t last[SYMBOLS_PER_WORD] = { 0 };
+		for (size_t i = full * SYMBOLS_PER_WORD; i < count; ++i)
+		{
+			last[i - full * SYMBOLS_PER_WORD] = sym[i];
+		}
+		words[full] = join(last);
+	}
+}
+
+void PackedFormat::unpack(const uint64_t* words, size_t count, uint8_t* sym)
+{
+	size_t full = count / SYMBOLS_PER_WORD;
+	size_t w = 0;
+	for (; w + 4 <= full; w += 4)
+	{
+		uint8_t* s = sym + w * SYMBOLS_PER_WORD;
+		split(words[w], s);
+		split(words[w + 1], s + 13);
+		split(words[w + 2], s + 26);
+		split(words[w + 3], s + 39);
+	}
+	for (; w < full; ++w)
+	{
+		split(words[w], sym + w * SYMBOLS_PER_WORD);
+	}
+	if (full * SYMBOLS_PER_WORD < count)
+	{
+		uint8_t last[SYMBOLS_PER_WORD];
+		split(words[full], last);
+		for (size_t i = full * SYMBOLS_PER_WORD; i < count; ++i)
+		{
+			sym[i] = last[i - full * SYMBOLS_PER_WORD];
+		}
+	}
+}
+
+size_t PackedFormat::words(size_t count)
+{
+	return (count + SYMBOLS_PER_WORD - 1) / SYMBOLS_PER_WORD;
+}
+
+std::string PackedFormat::encode(const uint8_t* sym, size_t count, unsigned int n, uint64_t length)
+{
+	//byte 5 would keep only n mod 256, and decode would then take the ciphertext for another key size
+	if (n > MAX_BLOCK)
+	{
+		return "";
+	}
+	size_t nw = words(count);
+	std::string out(HEADER + nw * 8, '\0');
+	unsigned char* p = reinterpret_cast<unsigned char*>(&out[0]);
+	for (int i = 0; i < 4; ++i)
+	{
+		p[i] = MAGIC[i];
+	}
+	p[4] = VERSION;
+	p[5] = static_cast<unsigned char>(n);
+	put64(p + 8, length);
+
+	std::vector<uint64_t> w(nw);
+	if (nw)
+	{
+		pack(sym, count, &w[0]);
+	}
+	for (size_t i = 0; i < nw; ++i)
+	{
+		put64(p + HEADER + i * 8, w[i]);
+	}
+	return out;
+}
+
+bool PackedFormat::decode(const std::string& data, unsigned int& n, uint64_t& length, std::vector<uint8_t>& sym)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+	if (data.length() < HEADER || data.compare(0, 4, MAGIC, 4) != 0 || p[4] != VERSION || p[5] < 2)
+	{
+		return false;
+	}
+	n = p[5];
+	length = get64(p + 8);
+	//bound length by the words present before rounding it up, so a huge length cannot wrap count
+	size_t available = (data.length() - HEADER) / 8;
+	if ((data.length() - HEADER) % 8 != 0 || length > static_cast<uint64_t>(available) * SYMBOLS_PER_WORD)
+	{
+		return false;
+	}
+	size_t count = (length + n - 1) / n * n;
+	size_t nw = words(count);
+	if (available != nw)
+	{
+		return false;
+	}
+
+	std::vector<uint64_t> w(nw);
+	for (size_t i = 0; i < nw; ++i)
+	{
+		w[i] = get64(p + HEADER + i * 8);
+		if (w[i] >= WORD_LIMIT)
+		{
+			return false; //would unpack to symbols the kernels' tables do not cover
+		}
+	}
+	sym.resize(count);
+	if (nw)
+	{
+		unpack(&w[0], count, &sym[0]);
+	}
+	return true;
+}
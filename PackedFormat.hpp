@@ -0,0 +1,70 @@
+#ifndef _PACKEDFORMAT_HPP_
+#define _PACKEDFORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Compact binary ciphertext: base-29 symbols packed 13 to a 64-bit word (29^13 < 2^64), about 38% smaller than one
+ * byte per symbol.  Layout, all integers little-endian:
+ *   bytes 0-3   magic "H29P"
+ *   byte  4     format version (1)
+ *   byte  5     block size n
+ *   bytes 6-7   reserved, zero
+ *   bytes 8-15  original (unpadded) text length
+ *   then ceil(padded length / 13) words, word w holding symbols 13w..13w+12 as sum s_j * 29^j.
+ */ 
+class PackedFormat
+{
+public:
+  static const size_t HEADER = 16; //bytes before the first word
+  static const size_t SYMBOLS_PER_WORD = 13;
+  static const unsigned int MAX_BLOCK = 255; //largest block size the one-byte header field holds
+
+  /**
+   * Packs symbols into words; a partial last word is filled with zero symbols.
+   * @param sym - symbols in [0,29).
+   * @param count - number of symbols.
+   * @param words - receives words(count) words.
+   */ 
+  static void pack( const uint8_t *sym, size_t count, uint64_t *words );
+
+  /**
+   * Unpacks the first count symbols from words.
+   * @param words - packed words.
+   * @param count - number of symbols to unpack.
+   * @param sym - receives count symbols.
+   */ 
+  static void unpack( const uint64_t *words, size_t count, uint8_t *sym );
+
+  /**
+   * Returns the number of words needed for a number of symbols.
+   * @param count - number of symbols.
+   * @return ceil(count / 13).
+   */ 
+  static size_t words( size_t count );
+
+  /**
+   * Builds a complete packed ciphertext: header followed by the packed symbols.
+   * @param sym - the ciphertext symbols, a whole number of blocks.
+   * @param count - number of symbols.
+   * @param n - block size of the key that produced them.
+   * @param length - original (unpadded) plaintext length.
+   * @return the encoded bytes, an empty string if n is larger than MAX_BLOCK.
+   */ 
+  static std::string encode( const uint8_t *sym, size_t count, unsigned int n, uint64_t length );
+
+  /**
+   * Parses a packed ciphertext produced by encode.
+   * @param data - the encoded bytes.
+   * @param n - receives the block size.
+   * @param length - receives the original (unpadded) length.
+   * @param sym - receives the padded ciphertext symbols.
+   * @return true if data is a well-formed packed ciphertext, false otherwise (bad header, a length the words cannot hold
+   *         or a word of 29^13 or more).
+   */ 
+  static bool decode( const std::string &data, unsigned int &n, uint64_t &length, std::vector<uint8_t> &sym );
+};
+#endif
@@ -0,0 +1,186 @@
+#include "Pipeline.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <thread>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	const unsigned int SPINS = 2000; //ring operations tried before sleeping
+}
+
+Pipeline::Pipeline(const BlockKernel& K, size_t chunk, unsigned int depth)
+	: K(K), spare(depth ? depth : 1), filled(depth ? depth : 1), done(depth ? depth : 1), failed(false), total(0), signal(0),
+	  sleepers(0)
+{
+	this->chunk = K.padded(chunk ? chunk : 1);
+	this->chunks.resize(depth ? depth : 1);
+}
+
+bool Pipeline::run(int in, int out)
+{
+	if (this->K.size() == 0)
+	{
+		return false;
+	}
+	this->failed = false;
+	this->total = 0;
+	for (size_t i = 0; i < this->chunks.size(); ++i)
+	{
+		this->chunks[i].data.resize(this->chunk);
+		this->give(this->spare, &this->chunks[i]);
+	}
+
+	std::thread r(&Pipeline::reader, this, in);
+	std::thread t(&Pipeline::transformer, this);
+	this->writer(out);
+	r.join();
+	t.join();
+
+	//empty the spare ring (reader has exited) so the next run() starts from a clean set of chunks
+	Chunk* c;
+	while (this->spare.pop(c))
+	{
+	}
+	return !this->failed;
+}
+
+size_t Pipeline::consumed() const
+{
+	return this->total;
+}
+
+//Private section
+void Pipeline::take(SpscRing<Chunk*>& ring, Chunk*& c)
+{
+	this->wait([&]() { return ring.pop(c); });
+	this->wake();
+}
+
+void Pipeline::give(SpscRing<Chunk*>& ring, Chunk* c)
+{
+	this->wait([&]() { return ring.push(c); });
+	this->wake();
+}
+
+//try SPINS times, then sleep between tries; the sleep is announced before the last try, so a stage that hands a
+//chunk over either sees the sleeper or the try sees its chunk
+template <typename Ready>
+void Pipeline::wait(Ready ready)
+{
+	for (unsigned int spins = 0; spins < SPINS; ++spins)
+	{
+		if (ready())
+		{
+			return;
+		}
+	}
+	this->sleepers.fetch_add(1, std::memory_order_seq_cst);
+	for (;;)
+	{
+		uint32_t seen = this->signal.load(std::memory_order_seq_cst);
+		if (ready())
+		{
+			break;
+		}
+		syscall(SYS_futex, &this->signal, FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+	}
+	this->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+//one word serves all three rings, so a wake may be for another stage; that stage's try fails and it sleeps again
+void Pipeline::wake()
+{
+	this->signal.fetch_add(1, std::memory_order_seq_cst);
+	if (this->sleepers.load(std::memory_order_seq_cst) > 0)
+	{
+		syscall(SYS_futex, &this->signal, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+}
+
+//fill each chunk completely (short reads are common on pipes) so only the last chunk can end in a partial block
+void Pipeline::reader(int in)
+{
+	bool last = false;
+	while (!last)
+	{
+		Chunk* c;
+		this->take(this->spare, c);
+		c->length = 0;
+		while (c->length < this->chunk && !this->failed)
+		{
+			ssize_t got = ::read(in, &c->data[c->length], this->chunk - c->length);
+			if (got > 0)
+			{
+				c->length += static_cast<size_t>(got);
+			}
+			else if (got < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else
+			{
+				if (got < 0)
+				{
+					this->failed = true;
+				}
+				last = true;
+				break;
+			}
+		}
+		if (this->failed)
+		{
+			last = true;
+		}
+		c->last = last;
+		this->total += c->length;
+		this->give(this->filled, c);
+	}
+}
+
+//chunk is a whole number of blocks, so padded(length) always fits in place
+void Pipeline::transformer()
+{
+	bool last = false;
+	while (!last)
+	{
+		Chunk* c;
+		this->take(this->filled, c);
+		if (!this->failed)
+		{
+			this->K.text(&c->data[0], c->length, &c->data[0]);
+			c->length = this->K.padded(c->length);
+		}
+		last = c->last;
+		this->give(this->done, c);
+	}
+}
+
+//after a failure keep draining so the other stages can finish, but stop writing
+void Pipeline::writer(int out)
+{
+	bool last = false;
+	while (!last)
+	{
+		Chunk* c;
+		this->take(this->done, c);
+		size_t off = 0;
+		while (off < c->length && !this->failed)
+		{
+			ssize_t put = ::write(out, &c->data[off], c->length - off);
+			if (put > 0)
+			{
+				off += static_cast<size_t>(put);
+			}
+			else if (!(put < 0 && errno == EINTR))
+			{
+				this->failed = true;
+			}
+		}
+		last = c->last;
+		this->give(this->spare, c);
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef _PIPELINE_HPP_
+#define _PIPELINE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "SpscRing.hpp"
+
+/**
+ * A three-stage read/transform/write pipeline between two file descriptors (pipes, sockets or files).  A reader,
+ * a transform and a writer thread pass fixed-size chunks through lock-free single-producer/single-consumer rings;
+ * the chunks are recycled from the writer back to the reader, so memory stays at depth chunks and a slow stage
+ * applies backpressure to the others.  A stage that finds its ring empty (or full) spins briefly and then sleeps on a
+ * futex, which the other stages only wake when someone is sleeping.
+ */ 
+class Pipeline
+{
+public:
+  /**
+   * Parameterized constructor.
+   * @param K - the prepared key to apply; it must outlive run().
+   * @param chunk - bytes per chunk, rounded up to a whole number of blocks.
+   * @param depth - number of chunks in flight.
+   */ 
+  Pipeline(const BlockKernel &K, size_t chunk = 1 << 20, unsigned int depth = 4);
+
+  /**
+   * Transforms everything read from in until end of file and writes the result to out; the last block is padded
+   * with '.' like Hill::encrypt.
+   * @param in - descriptor to read from.
+   * @param out - descriptor to write to.
+   * @return true if the whole input was transformed and written, false on an empty key or an I/O error.
+   */ 
+  bool run( int in, int out );
+
+  /**
+   * Returns the number of bytes read by the last run().
+   * @return input bytes consumed, before padding.
+   */ 
+  size_t consumed() const;
+
+private:
+  struct Chunk
+  {
+    std::vector<char> data;
+    size_t length; //valid bytes in data
+    bool last; //end of input (or error) follows this chunk
+  };
+
+  const BlockKernel &K;
+  size_t chunk;
+  std::vector<Chunk> chunks;
+  SpscRing<Chunk*> spare; //writer -> reader
+  SpscRing<Chunk*> filled; //reader -> transform
+  SpscRing<Chunk*> done; //transform -> writer
+  std::atomic<bool> failed;
+  size_t total; //written by the reader only, read after it has joined
+  std::atomic<uint32_t> signal; //futex word, bumped after every push or pop
+  std::atomic<uint32_t> sleepers; //stages inside the futex wait loop
+
+  void take(SpscRing<Chunk *> &ring, Chunk *&c);
+  void give(SpscRing<Chunk *> &ring, Chunk *c);
+  template <typename Ready> void wait(Ready ready);
+  void wake();
+  void reader(int in);
+  void transformer();
+  void writer(int out);
+};
+#endif
@@ -0,0 +1,300 @@
+#include "SharedKey.hpp"
+#include "Hill.hpp"
+
+//one per registered reader: the epoch it entered its read section in, 0 when outside
+struct SharedKey::Slot
+{
+	std::atomic<uint64_t> epoch;
+	std::atomic<bool> used;
+	Slot* next;
+};
+
+const unsigned int SharedKey::VERSIONS;
+const unsigned char SharedKey::MAGIC;
+
+namespace
+{
+	//derive D from E; both come back empty if E is not an invertible key
+	void keyPair(const Matrix& E, Matrix& outE, Matrix& outD)
+	{
+		Hill H(E, true);
+		outE = H.getE();
+		outD = H.getD();
+		if (outE.size(1) == 0 || outD.size(1) == 0)
+		{
+			std::vector<int> vec;
+			outE = Matrix(vec, 0, 0);
+			outD = Matrix(vec, 0, 0);
+		}
+	}
+}
+
+SharedKey::Snapshot::Snapshot(const Matrix& E, const Matrix& D, uint64_t version)
+	: E(E), D(D), EK(E), DK(D), version(version)
+{
+}
+
+SharedKey::Reader::Reader(SharedKey& key)
+	: key(key)
+{
+	for (Slot* s = key.slots.load(std::memory_order_acquire); s; s = s->next)
+	{
+		bool none = false;
+		if (s->used.compare_exchange_strong(none, true))
+		{
+			this->slot = s;
+			return;
+		}
+	}
+	Slot* s = new Slot;
+	s->epoch.store(0, std::memory_order_relaxed);
+	s->used.store(true, std::memory_order_relaxed);
+	s->next = key.slots.load(std::memory_order_relaxed);
+	while (!key.slots.compare_exchange_weak(s->next, s, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+	this->slot = s;
+}
+
+SharedKey::Reader::~Reader()
+{
+	this->slot->epoch.store(0, std::memory_order_release);
+	this->slot->used.store(false, std::memory_order_release);
+}
+
+//announce the epoch before loading the pointer: a rotation that swaps the pointer after this store sees the epoch in
+//its scan and keeps the snapshot; one that swapped before it is already visible to the load
+const SharedKey::Snapshot& SharedKey::Reader::lock()
+{
+	this->slot->epoch.store(this->key.epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+	return *this->key.current.load(std::memory_order_seq_cst);
+}
+
+void SharedKey::Reader::unlock()
+{
+	this->slot->epoch.store(0, std::memory_order_release);
+}
+
+std::string SharedKey::Reader::encrypt(const std::string& P)
+{
+	const Snapshot& s = this->lock();
+	std::string C(s.EK.padded(P.length()), ' ');
+	if (!P.empty() && s.EK.size())
+	{
+		s.EK.text(P.data(), P.length(), &C[0]);
+	}
+	this->unlock();
+	return C;
+}
+
+std::string SharedKey::Reader::decrypt(const std::string& C)
+{
+	const Snapshot& s = this->lock();
+	std::string P(s.DK.padded(C.length()), ' ');
+	if (!C.empty() && s.DK.size())
+	{
+		s.DK.text(C.data(), C.length(), &P[0]);
+	}
+	this->unlock();
+	return P;
+}
+
+std::string SharedKey::Reader::encryptFramed(const std::string& P)
+{
+	const Snapshot& s = this->lock();
+	std::string frame(1, static_cast<char>(SharedKey::MAGIC));
+	for (uint64_t v = s.version; ; v >>= 7)
+	{
+		frame += static_cast<char>((v & 0x7f) | (v >= 0x80 ? 0x80 : 0));
+		if (v < 0x80)
+		{
+			break;
+		}
+	}
+	size_t header = frame.length();
+	frame.resize(header + s.EK.padded(P.length()));
+	if (!P.empty() && s.EK.size())
+	{
+		s.EK.text(P.data(), P.length(), &frame[header]);
+	}
+	this->unlock();
+	return frame;
+}
+
+//the version cache is read inside the same read section as the key, so an evicted snapshot cannot be freed under us
+bool SharedKey::Reader::decryptFramed(const std::string& frame, std::string& P)
+{
+	uint64_t version;
+	size_t header;
+	if (!SharedKey::frameVersion(frame, version, header))
+	{
+		return false;
+	}
+	this->lock();
+	const Snapshot* s = nullptr;
+	for (unsigned int i = 0; i < SharedKey::VERSIONS && !s; ++i)
+	{
+		const Snapshot* r = this->key.recent[i].load(std::memory_order_acquire);
+		if (r && r->version == version)
+		{
+			s = r;
+		}
+	}
+	if (s && s->DK.size())
+	{
+		size_t length = frame.length() - header;
+		P.assign(s->DK.padded(length), ' ');
+		if (length)
+		{
+			s->DK.text(&frame[header], length, &P[0]);
+		}
+	}
+	this->unlock();
+	return s && s->DK.size();
+}
+
+SharedKey::SharedKey(const Matrix& E)
+	: epoch(1), slots(nullptr)
+{
+	Matrix e;
+	Matrix d;
+	keyPair(E, e, d);
+	const Snapshot* first = new Snapshot(e, d, 1);
+	for (unsigned int i = 0; i < VERSIONS; ++i)
+	{
+		this->recent[i].store(i ? nullptr : first, std::memory_order_relaxed);
+	}
+	this->cursor = 1;
+	this->highest = 1;
+	this->current.store(first, std::memory_order_release);
+}
+
+//the current snapshot is always in the cache, so freeing the cache and the garbage frees everything
+SharedKey::~SharedKey()
+{
+	for (unsigned int i = 0; i < VERSIONS; ++i)
+	{
+		delete this->recent[i].load();
+	}
+	for (size_t i = 0; i < this->garbage.size(); ++i)
+	{
+		delete this->garbage[i].first;
+	}
+	for (Slot* s = this->slots.load(); s; )
+	{
+		Slot* next = s->next;
+		delete s;
+		s = next;
+	}
+}
+
+bool SharedKey::rotate(const Matrix& E)
+{
+	Matrix e;
+	Matrix d;
+	keyPair(E, e, d);
+	return e.size(1) != 0 && this->publish(e, d, 0, true);
+}
+
+bool SharedKey::rotate(const Matrix& E, uint64_t version)
+{
+	Matrix e;
+	Matrix d;
+	keyPair(E, e, d);
+	return e.size(1) != 0 && this->publish(e, d, version, false);
+}
+
+bool SharedKey::frameVersion(const std::string& frame, uint64_t& version, size_t& header)
+{
+	if (frame.length() < 2 || static_cast<unsigned char>(frame[0]) != MAGIC)
+	{
+		return false;
+	}
+	//at most 10 bytes, the 10th holding only bit 63; a zero last byte after the first would be a non-minimal encoding
+	version = 0;
+	for (size_t i = 1; i < frame.length() && i < 11; ++i)
+	{
+		unsigned char b = static_cast<unsigned char>(frame[i]);
+		if (i == 10 && b > 1)
+		{
+			return false;
+		}
+		version |= static_cast<uint64_t>(b & 0x7f) << (7 * (i - 1));
+		if (!(b & 0x80))
+		{
+			header = i + 1;
+			return b != 0 || i == 1;
+		}
+	}
+	return false;
+}
+
+unsigned int SharedKey::size() const
+{
+	return this->current.load(std::memory_order_acquire)->EK.size();
+}
+
+size_t SharedKey::retired() const
+{
+	std::lock_guard<std::mutex> guard(this->writer);
+	return this->garbage.size();
+}
+
+//Private section
+bool SharedKey::publish(const Matrix& E, const Matrix& D, uint64_t version, bool next)
+{
+	std::lock_guard<std::mutex> guard(this->writer);
+	//a version at or below the high-water mark may still name frames made under an evicted key
+	if (next)
+	{
+		if (this->highest == ~0ULL)
+		{
+			return false;
+		}
+		version = this->highest + 1;
+	}
+	else if (version <= this->highest)
+	{
+		return false;
+	}
+	this->highest = version;
+	const Snapshot* fresh = new Snapshot(E, D, version);
+	const Snapshot* evicted = this->recent[this->cursor].exchange(fresh, std::memory_order_seq_cst);
+	this->cursor = (this->cursor + 1) % VERSIONS;
+	this->current.store(fresh, std::memory_order_seq_cst);
+	//readers that announce an epoch from here on cannot find evicted, so it is only reachable from earlier epochs
+	uint64_t replaced = this->epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+	if (evicted)
+	{
+		this->garbage.push_back(std::make_pair(evicted, replaced));
+	}
+	this->reclaim();
+	return true;
+}
+
+//a snapshot replaced at epoch r is free once no reader is inside a section entered before r
+void SharedKey::reclaim()
+{
+	uint64_t oldest = this->epoch.load(std::memory_order_seq_cst);
+	for (Slot* s = this->slots.load(std::memory_order_acquire); s; s = s->next)
+	{
+		uint64_t e = s->epoch.load(std::memory_order_seq_cst);
+		if (e != 0 && e < oldest)
+		{
+			oldest = e;
+		}
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < this->garbage.size(); ++i)
+	{
+		if (this->garbage[i].second <= oldest)
+		{
+			delete this->garbage[i].first;
+		}
+		else
+		{
+			this->garbage[kept++] = this->garbage[i];
+		}
+	}
+	this->garbage.resize(kept);
+}
@@ -0,0 +1,179 @@
+#ifndef _SHAREDKEY_HPP_
+#define _SHAREDKEY_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "Matrix.hpp"
+
+/**
+ * A key that can be rotated while other threads encrypt with it (read-copy-update).  Every key is an immutable
+ * snapshot published through one atomic pointer; a rotation builds the new snapshot off to the side and swaps the
+ * pointer, so readers never wait and never see a half-written key.  The last VERSIONS snapshots stay cached by version
+ * so framed ciphertexts made under a recent key still decrypt during a rollover; snapshots that drop out of the cache
+ * are freed by later rotations once every reader that might still hold them has left its read section (epoch-based
+ * reclamation).
+ *
+ * Framed ciphertext: the byte MAGIC, which is outside the alphabet so no plain ciphertext starts with it, the key
+ * version as a minimal unsigned LEB128 varint (one byte below 128), then the ciphertext.  Versions only grow: a
+ * version that was ever published is never handed out again, even after it left the cache.
+ */ 
+class SharedKey
+{
+  struct Slot;
+
+public:
+  /**
+   * An immutable prepared key pair.
+   */ 
+  struct Snapshot
+  {
+    Matrix E;
+    Matrix D;
+    BlockKernel EK;
+    BlockKernel DK;
+    uint64_t version; //1 for the first key, then the highest version so far + 1 unless given to rotate()
+
+    Snapshot(const Matrix &E, const Matrix &D, uint64_t version);
+  };
+
+  /**
+   * A reader's handle; each thread that reads the key owns one.  lock() and unlock() are wait-free: two stores and a
+   * load, no read-modify-write and no loop.
+   */ 
+  class Reader
+  {
+  public:
+    /**
+     * Parameterized constructor.  Registers the reader with the key, reusing the slot of a departed reader if any.
+     * @param key - the key to read; it must outlive the reader.
+     */ 
+    explicit Reader(SharedKey &key);
+
+    /**
+     * Destructor.  Gives the slot back for another reader.
+     */ 
+    ~Reader();
+
+    Reader(const Reader &) = delete;
+    Reader & operator=(const Reader &) = delete;
+
+    /**
+     * Enters a read section.
+     * @return the current snapshot; it stays valid until unlock().
+     */ 
+    const Snapshot & lock();
+
+    /**
+     * Leaves the read section; the snapshot from lock() must not be used afterwards.
+     */ 
+    void unlock();
+
+    /**
+     * Encrypts with the current key; a convenience for lock(), encrypt, unlock().
+     * @param P - the plaintext.
+     * @return the ciphertext, padded like Hill::encrypt.
+     */ 
+    std::string encrypt( const std::string & P );
+
+    /**
+     * Decrypts with the current key; a convenience for lock(), decrypt, unlock().
+     * @param C - the ciphertext.
+     * @return the plaintext, padded like Hill::decrypt.
+     */ 
+    std::string decrypt( const std::string & C );
+
+    /**
+     * Encrypts with the current key and prefixes the ciphertext with the key's version.
+     * @param P - the plaintext.
+     * @return the framed ciphertext.
+     */ 
+    std::string encryptFramed( const std::string & P );
+
+    /**
+     * Decrypts a framed ciphertext with the key version named in its header, which may be any cached version.
+     * @param frame - the framed ciphertext.
+     * @param P - receives the plaintext, padded like Hill::decrypt.
+     * @return true if decrypted, false if the frame is malformed or its key version is no longer cached.
+     */ 
+    bool decryptFramed( const std::string & frame, std::string & P );
+
+  private:
+    SharedKey &key;
+    Slot *slot;
+  };
+
+  /**
+   * Parameterized constructor.  If E is not an invertible key the shared key starts empty (size() == 0).
+   * @param E - the first encryption key; the decryption key is derived from it.
+   */ 
+  explicit SharedKey(const Matrix &E);
+
+  /**
+   * Destructor.  Frees every snapshot; no reader may be inside a read section.
+   */ 
+  ~SharedKey();
+
+  SharedKey(const SharedKey &) = delete;
+  SharedKey & operator=(const SharedKey &) = delete;
+
+  /**
+   * Publishes a new key and frees the snapshots no reader can still see.  Concurrent rotations are serialized with
+   * each other, never with readers.
+   * @param E - the new encryption key; the decryption key is derived from it.
+   * @return true if the key was replaced, false if E is not invertible mod 29 (the old key stays).
+   */ 
+  bool rotate( const Matrix & E );
+
+  /**
+   * Publishes a new key under a version chosen by the caller, e.g. one agreed with other processes.
+   * @param E - the new encryption key; the decryption key is derived from it.
+   * @param version - the new key's version; it must be above every version published so far.
+   * @return true if the key was replaced, false if E is not invertible mod 29 or the version is not above the highest
+   *         one so far.
+   */ 
+  bool rotate( const Matrix & E, uint64_t version );
+
+  /**
+   * Reads the header of a framed ciphertext.
+   * @param frame - the framed ciphertext.
+   * @param version - receives the key version.
+   * @param header - receives the header length; the ciphertext starts there.
+   * @return true if frame starts with a well-formed header, false otherwise (e.g. an overlong or non-minimal varint).
+   */ 
+  static bool frameVersion( const std::string & frame, uint64_t & version, size_t & header );
+
+  /**
+   * Returns the block size of the current key.
+   * @return n, or 0 if no valid key was ever set.
+   */ 
+  unsigned int size() const;
+
+  /**
+   * Returns the number of replaced snapshots not yet freed because a reader might still hold them.
+   * @return the retired count.
+   */ 
+  size_t retired() const;
+
+  static const unsigned int VERSIONS = 8; //snapshots kept for decryptFramed, the current one included
+  static const unsigned char MAGIC = 0xFF; //first byte of a framed ciphertext
+
+private:
+  std::atomic<const Snapshot *> current;
+  std::atomic<const Snapshot *> recent[VERSIONS]; //by insertion, round robin
+  unsigned int cursor; //recent entry the next rotation overwrites
+  uint64_t highest; //largest version ever published, guarded by writer
+  std::atomic<uint64_t> epoch; //advanced by every rotation
+  std::atomic<Slot *> slots; //registered readers, a list that only grows
+  mutable std::mutex writer; //serializes rotations and guards garbage
+  std::vector<std::pair<const Snapshot *, uint64_t> > garbage; //snapshot, epoch at which it left the cache
+
+  bool publish(const Matrix & E, const Matrix & D, uint64_t version, bool next);
+  void reclaim();
+};
+#endif
@@ -0,0 +1,164 @@
+#include "ShmClient.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ShmClient::ShmClient()
+{
+	this->segment = nullptr;
+	this->index = -1;
+	this->pending = 0;
+}
+
+//the server still writes into slots that are in flight, so their replies are awaited before the entry can be claimed
+//by another client; a stopping server answers nothing more, and then there is nothing left to wait for
+ShmClient::~ShmClient()
+{
+	if (this->segment)
+	{
+		uint32_t done;
+		while (this->pending > 0 && this->segment->clients[this->index].responses.take(done, this->segment->stopping))
+		{
+			--this->pending;
+		}
+		this->segment->clients[this->index].owner.store(0, std::memory_order_release);
+		::munmap(this->segment, sizeof(ShmSegment));
+	}
+}
+
+bool ShmClient::attach(const std::string& name)
+{
+	if (this->segment)
+	{
+		return false;
+	}
+	int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	void* p = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == sizeof(ShmSegment))
+	{
+		p = ::mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (p == MAP_FAILED)
+	{
+		return false;
+	}
+	ShmSegment* s = static_cast<ShmSegment*>(p);
+	uint32_t pid = static_cast<uint32_t>(::getpid());
+	for (unsigned int c = 0; s->magic == ShmSegment::MAGIC && c < ShmSegment::CLIENTS; ++c)
+	{
+		uint32_t none = 0;
+		if (s->clients[c].owner.compare_exchange_strong(none, pid))
+		{
+			//drop replies a previous owner left behind because the server stopped before it could wait for them
+			uint32_t stale;
+			while (s->clients[c].responses.pop(stale))
+			{
+			}
+			this->segment = s;
+			this->index = static_cast<int>(c);
+			for (int i = ShmSegment::SLOTS - 1; i >= 0; --i)
+			{
+				this->free.push_back(i);
+			}
+			return true;
+		}
+	}
+	::munmap(p, sizeof(ShmSegment));
+	return false;
+}
+
+unsigned int ShmClient::blockSize() const
+{
+	return this->segment ? this->segment->n : 0;
+}
+
+int ShmClient::acquire()
+{
+	if (this->free.empty())
+	{
+		return -1;
+	}
+	int slot = this->free.back();
+	this->free.pop_back();
+	return slot;
+}
+
+char* ShmClient::buffer(int slot)
+{
+	return this->segment->clients[this->index].slots[slot].data;
+}
+
+bool ShmClient::submit(int slot, uint8_t op, size_t length)
+{
+	if (!this->segment || slot < 0 || slot >= static_cast<int>(ShmSegment::SLOTS) || length > ShmSegment::SLOT_BYTES)
+	{
+		return false;
+	}
+	ShmSegment::Slot& s = this->segment->clients[this->index].slots[slot];
+	s.length = static_cast<uint32_t>(length);
+	s.op = op;
+	s.status = ShmSegment::PENDING;
+	++this->pending;
+	this->segment->requests.give(static_cast<uint32_t>(this->index) * ShmSegment::SLOTS + slot);
+	return true;
+}
+
+bool ShmClient::complete(int& slot, size_t& length)
+{
+	uint32_t done;
+	slot = -1;
+	if (!this->segment || !this->segment->clients[this->index].responses.take(done, this->segment->stopping))
+	{
+		return false;
+	}
+	--this->pending;
+	slot = static_cast<int>(done);
+	const ShmSegment::Slot& s = this->segment->clients[this->index].slots[slot];
+	length = s.length;
+	return s.status == ShmSegment::OK;
+}
+
+void ShmClient::release(int slot)
+{
+	this->free.push_back(slot);
+}
+
+bool ShmClient::call(uint8_t op, const std::string& text, std::string& result)
+{
+	int slot = this->acquire();
+	if (slot < 0)
+	{
+		return false;
+	}
+	if (!text.empty())
+	{
+		std::memcpy(this->buffer(slot), text.data(), text.size() < ShmSegment::SLOT_BYTES ? text.size() : ShmSegment::SLOT_BYTES);
+	}
+	if (!this->submit(slot, op, text.size()))
+	{
+		this->release(slot);
+		return false;
+	}
+	int done;
+	size_t length;
+	bool ok = this->complete(done, length);
+	if (done < 0)
+	{
+		return false; //the server stopped; the slot may still be queued, so it is not reused
+	}
+	if (ok)
+	{
+		result.assign(this->buffer(done), length);
+	}
+	this->release(done);
+	return ok;
+}
@@ -0,0 +1,97 @@
+#ifndef _SHMCLIENT_HPP_
+#define _SHMCLIENT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ShmServer.hpp"
+
+/**
+ * A client of ShmServer.  It claims one of the segment's client entries and writes requests straight into its shared
+ * buffers: acquire() a slot, fill buffer(slot), submit() it, and complete() hands back the finished slot with the
+ * result in the same buffer.  Several slots may be in flight at once; call() wraps the whole round trip for one text.
+ */ 
+class ShmClient
+{
+public:
+  /**
+   * Default constructor.  It creates a detached client.
+   */ 
+  ShmClient();
+
+  /**
+   * Destructor.  Waits for the replies to every submitted request not yet completed, unless the server is stopping,
+   * then releases the client entry and unmaps the segment.
+   */ 
+  ~ShmClient();
+
+  ShmClient(const ShmClient &) = delete;
+  ShmClient & operator=(const ShmClient &) = delete;
+
+  /**
+   * Maps a running server's segment and claims a free client entry.
+   * @param name - the name the server was started with.
+   * @return true if attached, false if there is no such segment or every client entry is taken.
+   */ 
+  bool attach( const std::string & name );
+
+  /**
+   * Returns the block size of the server's key.
+   * @return n, or 0 if detached.
+   */ 
+  unsigned int blockSize() const;
+
+  /**
+   * Takes a free slot.
+   * @return a slot number, or -1 if all SLOTS are in flight or the client is detached.
+   */ 
+  int acquire();
+
+  /**
+   * Returns the shared buffer of a slot: the request text goes here and the result comes back here.
+   * @param slot - a slot from acquire().
+   * @return ShmSegment::SLOT_BYTES writable bytes.
+   */ 
+  char * buffer( int slot );
+
+  /**
+   * Queues a slot for the server.
+   * @param slot - a slot from acquire() whose buffer holds the text.
+   * @param op - ShmSegment::ENCRYPT or ShmSegment::DECRYPT.
+   * @param length - text length; the padded length must fit in SLOT_BYTES.
+   * @return true if queued, false if the arguments are invalid.
+   */ 
+  bool submit( int slot, uint8_t op, size_t length );
+
+  /**
+   * Waits for the next finished request.
+   * @param slot - receives the finished slot; it stays owned by the caller until release().
+   * @param length - receives the length of the result in buffer(slot).
+   * @return true if the request succeeded, false if it was rejected or the server stopped (slot is -1 then).
+   */ 
+  bool complete( int & slot, size_t & length );
+
+  /**
+   * Gives a finished slot back for reuse.
+   * @param slot - a slot returned by complete().
+   */ 
+  void release( int slot );
+
+  /**
+   * Transforms one text with a full round trip; nothing else may be in flight.
+   * @param op - ShmSegment::ENCRYPT or ShmSegment::DECRYPT.
+   * @param text - the text to transform.
+   * @param result - receives the transformed text.
+   * @return true on success, false otherwise.
+   */ 
+  bool call( uint8_t op, const std::string & text, std::string & result );
+
+private:
+  ShmSegment *segment;
+  int index; //claimed client entry
+  std::vector<int> free; //slots not in flight
+  unsigned int pending; //submitted requests whose reply complete() has not taken yet
+};
+#endif
@@ -0,0 +1,166 @@
+#ifndef _SHMQUEUE_HPP_
+#define _SHMQUEUE_HPP_
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * A bounded lock-free queue of 32-bit values for any number of producers and consumers, laid out so it can live in
+ * memory shared between processes (every member is a lock-free atomic or plain data; no pointers).  Each cell carries
+ * a sequence number that tells producers and consumers whose turn it is (Vyukov's bounded queue).  Consumers that
+ * find the queue empty spin briefly and then sleep on a futex, which producers only wake when someone is sleeping.
+ * N must be a power of two.
+ */ 
+template <size_t N>
+class ShmQueue
+{
+public:
+  /**
+   * Default constructor.  Marks every cell free; run it once, in the process that creates the shared segment.
+   */ 
+  ShmQueue() : head(0), tail(0), signal(0), sleepers(0)
+  {
+    for (size_t i = 0; i < N; ++i)
+    {
+      this->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Appends a value without blocking.
+   * @param value - the value to append.
+   * @return true if appended, false if the queue is full.
+   */ 
+  bool push(uint32_t value)
+  {
+    uint64_t pos = this->tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell &c = this->cells[pos & (N - 1)];
+      int64_t diff = static_cast<int64_t>(c.sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(pos);
+      if (diff == 0 && this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        c.value = value;
+        c.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+      if (diff < 0)
+      {
+        return false;
+      }
+      if (diff > 0)
+      {
+        pos = this->tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Removes the oldest value without blocking.
+   * @param value - receives the value.
+   * @return true if a value was removed, false if the queue is empty.
+   */ 
+  bool pop(uint32_t &value)
+  {
+    uint64_t pos = this->head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Cell &c = this->cells[pos & (N - 1)];
+      int64_t diff = static_cast<int64_t>(c.sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(pos + 1);
+      if (diff == 0 && this->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        value = c.value;
+        c.sequence.store(pos + N, std::memory_order_release);
+        return true;
+      }
+      if (diff < 0)
+      {
+        return false;
+      }
+      if (diff > 0)
+      {
+        pos = this->head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Appends a value, spinning while the queue is full, and wakes a sleeping consumer.
+   * @param value - the value to append.
+   */ 
+  void give(uint32_t value)
+  {
+    while (!this->push(value))
+    {
+    }
+    this->signal.fetch_add(1, std::memory_order_seq_cst);
+    if (this->sleepers.load(std::memory_order_seq_cst) > 0)
+    {
+      syscall(SYS_futex, &this->signal, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+  }
+
+  /**
+   * Removes the oldest value, spinning and then sleeping while the queue is empty.
+   * @param value - receives the value.
+   * @param stop - checked between sleeps; when it becomes non-zero the call gives up.
+   * @return true if a value was removed, false if stop was raised first.
+   */ 
+  bool take(uint32_t &value, const std::atomic<uint32_t> &stop)
+  {
+    for (unsigned int spins = 0; spins < SPINS; ++spins)
+    {
+      if (this->pop(value))
+      {
+        return true;
+      }
+    }
+    //announce the sleep before the last look, so a producer either sees the sleeper or the look sees its value
+    this->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    bool got = false;
+    while (!stop.load(std::memory_order_acquire))
+    {
+      uint32_t seen = this->signal.load(std::memory_order_seq_cst);
+      if (this->pop(value))
+      {
+        got = true;
+        break;
+      }
+      timespec timeout = { 0, 50 * 1000 * 1000 }; //re-check stop even if no producer ever comes
+      syscall(SYS_futex, &this->signal, FUTEX_WAIT, seen, &timeout, nullptr, 0);
+    }
+    this->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    return got;
+  }
+
+  /**
+   * Wakes every sleeping consumer, e.g. after raising the stop flag passed to take.
+   */ 
+  void wakeAll()
+  {
+    this->signal.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, &this->signal, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+private:
+  static const unsigned int SPINS = 2000; //pops tried before sleeping
+
+  struct Cell
+  {
+    std::atomic<uint64_t> sequence;
+    uint32_t value;
+  };
+
+  alignas(64) std::atomic<uint64_t> head; //next position to pop
+  alignas(64) std::atomic<uint64_t> tail; //next position to push
+  alignas(64) std::atomic<uint32_t> signal; //futex word, bumped on every give
+  std::atomic<uint32_t> sleepers; //consumers inside the futex wait loop
+  Cell cells[N];
+};
+#endif
@@ -0,0 +1,118 @@
+#include "ShmServer.hpp"
+
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+ShmSegment::ShmSegment()
+	: magic(MAGIC), n(0), stopping(0)
+{
+	for (unsigned int c = 0; c < CLIENTS; ++c)
+	{
+		this->clients[c].owner.store(0, std::memory_order_relaxed);
+	}
+}
+
+ShmServer::ShmServer(const Hill& H)
+	: EK(H.getE()), DK(H.getD())
+{
+	this->segment = nullptr;
+}
+
+ShmServer::~ShmServer()
+{
+	this->stop();
+}
+
+bool ShmServer::start(const std::string& name, unsigned int threads)
+{
+	if (this->segment || this->EK.size() == 0 || this->DK.size() == 0)
+	{
+		return false;
+	}
+	::shm_unlink(name.c_str());
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+	{
+		return false;
+	}
+	void* p = MAP_FAILED;
+	if (::ftruncate(fd, sizeof(ShmSegment)) == 0)
+	{
+		p = ::mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (p == MAP_FAILED)
+	{
+		::shm_unlink(name.c_str());
+		return false;
+	}
+	this->name = name;
+	this->segment = new (p) ShmSegment();
+	this->segment->n = this->EK.size();
+
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	for (unsigned int i = 0; i < (threads ? threads : 1); ++i)
+	{
+		this->workers.push_back(std::thread(&ShmServer::work, this));
+	}
+	return true;
+}
+
+void ShmServer::stop()
+{
+	if (!this->segment)
+	{
+		return;
+	}
+	this->segment->stopping.store(1, std::memory_order_release);
+	this->segment->requests.wakeAll();
+	for (size_t i = 0; i < this->workers.size(); ++i)
+	{
+		this->workers[i].join();
+	}
+	this->workers.clear();
+
+	//wake clients blocked on a reply so they notice the server is gone
+	for (unsigned int c = 0; c < ShmSegment::CLIENTS; ++c)
+	{
+		this->segment->clients[c].responses.wakeAll();
+	}
+	::munmap(this->segment, sizeof(ShmSegment));
+	::shm_unlink(this->name.c_str());
+	this->segment = nullptr;
+}
+
+//Private section
+//the text is transformed where the client wrote it; only the slot number travels through the queues
+void ShmServer::work()
+{
+	ShmSegment& s = *this->segment;
+	uint32_t request;
+	while (s.requests.take(request, s.stopping))
+	{
+		unsigned int c = request / ShmSegment::SLOTS;
+		unsigned int i = request % ShmSegment::SLOTS;
+		if (c >= ShmSegment::CLIENTS)
+		{
+			continue;
+		}
+		ShmSegment::Slot& slot = s.clients[c].slots[i];
+		const BlockKernel& K = (slot.op == ShmSegment::DECRYPT) ? this->DK : this->EK;
+		if ((slot.op == ShmSegment::ENCRYPT || slot.op == ShmSegment::DECRYPT) && K.padded(slot.length) <= ShmSegment::SLOT_BYTES)
+		{
+			K.text(slot.data, slot.length, slot.data);
+			slot.length = static_cast<uint32_t>(K.padded(slot.length));
+			slot.status = ShmSegment::OK;
+		}
+		else
+		{
+			slot.status = ShmSegment::BAD_REQUEST;
+		}
+		s.clients[c].responses.give(i);
+	}
+}
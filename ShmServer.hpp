@@ -0,0 +1,99 @@
+#ifndef _SHMSERVER_HPP_
+#define _SHMSERVER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "Hill.hpp"
+#include "ShmQueue.hpp"
+
+/**
+ * Layout of the shared-memory segment used by ShmServer and ShmClient.  Each client owns SLOTS fixed buffers; a
+ * request names a buffer by (client, slot), the server transforms the text in place, and the slot number comes back on
+ * the client's own response queue, so no text is ever copied between processes.
+ */ 
+struct ShmSegment
+{
+  static const uint32_t MAGIC = 0x53393248; //"H29S"
+  static const unsigned int CLIENTS = 16;
+  static const unsigned int SLOTS = 64; //buffers per client
+  static const size_t SLOT_BYTES = 4096; //capacity of one buffer, padding included
+
+  enum Op { ENCRYPT = 0, DECRYPT = 1 };
+  enum Status { PENDING = 0, OK = 1, BAD_REQUEST = 2 };
+
+  struct Slot
+  {
+    uint32_t length; //text length, before the request; padded length after it
+    uint8_t op;
+    uint8_t status;
+    char data[SLOT_BYTES];
+  };
+
+  struct Client
+  {
+    std::atomic<uint32_t> owner; //pid of the attached client, 0 if free
+    ShmQueue<SLOTS> responses; //finished slot numbers
+    Slot slots[SLOTS];
+  };
+
+  uint32_t magic;
+  unsigned int n; //block size of the server's key
+  std::atomic<uint32_t> stopping;
+  ShmQueue<CLIENTS * SLOTS> requests; //client * SLOTS + slot
+  Client clients[CLIENTS];
+
+  ShmSegment();
+};
+
+/**
+ * An encryption service for processes on the same host: a POSIX shared-memory segment (/dev/shm) holding a
+ * multi-producer request queue and one response queue per client, served by a pool of worker threads that run the
+ * block kernel directly on the clients' buffers.  Workers and clients spin briefly on an empty queue and then sleep on
+ * a futex, so an idle service costs no CPU.
+ */ 
+class ShmServer
+{
+public:
+  /**
+   * Parameterized constructor.
+   * @param H - the cipher whose keys serve every request; its keys are copied, so it need not outlive the server.
+   */ 
+  explicit ShmServer(const Hill &H);
+
+  /**
+   * Destructor.  Stops the workers and removes the segment.
+   */ 
+  ~ShmServer();
+
+  ShmServer(const ShmServer &) = delete;
+  ShmServer & operator=(const ShmServer &) = delete;
+
+  /**
+   * Creates the segment and starts the workers.
+   * @param name - shared-memory object name, e.g. "/hill"; an existing object of that name is replaced.
+   * @param threads - number of workers, 0 for one per hardware thread.
+   * @return true if the service is running, false if the key is invalid or the segment could not be created.
+   */ 
+  bool start( const std::string & name, unsigned int threads = 0 );
+
+  /**
+   * Stops the workers; requests still queued are not answered.
+   */ 
+  void stop();
+
+private:
+  BlockKernel EK;
+  BlockKernel DK;
+  std::string name;
+  ShmSegment *segment;
+  std::vector<std::thread> workers;
+
+  void work();
+};
+#endif
@@ -0,0 +1,61 @@
+#ifndef _SPSCRING_HPP_
+#define _SPSCRING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * A bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+ */ 
+template <typename T>
+class SpscRing
+{
+public:
+  /**
+   * Parameterized constructor.
+   * @param capacity - maximum number of queued elements.
+   */ 
+  explicit SpscRing(size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+  /**
+   * Appends an element; only the producer thread may call this.
+   * @param value - the element to append.
+   * @return true if appended, false if the ring is full.
+   */ 
+  bool push(const T &value)
+  {
+    size_t t = this->tail.load(std::memory_order_relaxed);
+    size_t next = (t + 1 == this->slots.size()) ? 0 : t + 1;
+    if (next == this->head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    this->slots[t] = value;
+    this->tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Removes the oldest element; only the consumer thread may call this.
+   * @param value - receives the element.
+   * @return true if an element was removed, false if the ring is empty.
+   */ 
+  bool pop(T &value)
+  {
+    size_t h = this->head.load(std::memory_order_relaxed);
+    if (h == this->tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    value = this->slots[h];
+    this->head.store((h + 1 == this->slots.size()) ? 0 : h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<T> slots; //one slot stays empty to tell full from empty
+  alignas(64) std::atomic<size_t> head; //next slot to pop, written by the consumer
+  alignas(64) std::atomic<size_t> tail; //next slot to push, written by the producer
+};
+#endif
@@ -0,0 +1,150 @@
+#include "ThreadPool.hpp"
+
+#include <chrono>
+
+namespace
+{
+	//the pool and deque the calling thread works for, if any
+	thread_local const void* currentPool = nullptr;
+	thread_local unsigned int currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: queued(0), pending(0), sleeping(0), next(0), stolen(0)
+{
+	this->stopping = false;
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+	for (unsigned int i = 0; i < threads; ++i)
+	{
+		this->queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+	for (unsigned int i = 0; i < threads; ++i)
+	{
+		this->workers.push_back(std::thread(&ThreadPool::run, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->ready.notify_all();
+	for (size_t i = 0; i < this->workers.size(); ++i)
+	{
+		this->workers[i].join();
+	}
+}
+
+//the pool lock is only taken when a worker is asleep, so a busy pool submits with one deque lock
+void ThreadPool::submit(const std::function<void()>& task)
+{
+	unsigned int index = (currentPool == this) ? currentIndex : this->next++ % this->queues.size();
+	++this->pending;
+	this->queued.fetch_add(1, std::memory_order_seq_cst);
+	{
+		std::lock_guard<std::mutex> guard(this->queues[index]->lock);
+		this->queues[index]->tasks.push_back(task);
+	}
+	if (this->sleeping.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->ready.notify_one();
+	}
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	while (this->pending != 0)
+	{
+		this->idle.wait(guard);
+	}
+}
+
+bool ThreadPool::wait(unsigned int milliseconds)
+{
+	std::unique_lock<std::mutex> guard(this->lock);
+	return this->idle.wait_for(guard, std::chrono::milliseconds(milliseconds), [this]() { return this->pending == 0; });
+}
+
+unsigned int ThreadPool::size() const
+{
+	return static_cast<unsigned int>(this->workers.size());
+}
+
+size_t ThreadPool::steals() const
+{
+	return this->stolen.load();
+}
+
+//Private section
+//own deque newest first (its data is still in cache), then the oldest task of the other deques in turn
+bool ThreadPool::take(unsigned int index, std::function<void()>& task)
+{
+	size_t count = this->queues.size();
+	for (size_t k = 0; k < count; ++k)
+	{
+		Queue& q = *this->queues[(index + k) % count];
+		std::lock_guard<std::mutex> guard(q.lock);
+		if (q.tasks.empty())
+		{
+			continue;
+		}
+		if (k == 0)
+		{
+			task.swap(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else
+		{
+			task.swap(q.tasks.front());
+			q.tasks.pop_front();
+			++this->stolen;
+		}
+		--this->queued;
+		return true;
+	}
+	return false;
+}
+
+//worker loop: run tasks while any deque has one, sleep otherwise, exit once stopping and nothing is left
+void ThreadPool::run(unsigned int index)
+{
+	currentPool = this;
+	currentIndex = index;
+	while (true)
+	{
+		std::function<void()> task;
+		if (this->take(index, task))
+		{
+			task();
+			if (--this->pending == 0)
+			{
+				std::lock_guard<std::mutex> guard(this->lock);
+				this->idle.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(this->lock);
+		if (this->stopping && this->queued.load() == 0)
+		{
+			return;
+		}
+		this->sleeping.fetch_add(1, std::memory_order_seq_cst);
+		while (this->queued.load(std::memory_order_seq_cst) == 0 && !this->stopping)
+		{
+			this->ready.wait(guard);
+		}
+		this->sleeping.fetch_sub(1, std::memory_order_seq_cst);
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef _THREADPOOL_HPP_
+#define _THREADPOOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed-size pool of worker threads that run submitted tasks.  Used to spread independent block ranges over all cores.
+ * Every worker has its own deque: tasks submitted from inside a task go to the submitting worker's deque and are run
+ * newest first, while an idle worker steals the oldest task from another worker's deque.  A task that splits a large
+ * job into pieces therefore keeps the pieces local until other workers run dry, and then they take them over.
+ */ 
+class ThreadPool
+{
+public:
+  /**
+   * Parameterized constructor.  Starts the worker threads.
+   * @param threads - number of workers, 0 for one per hardware thread.
+   */ 
+  explicit ThreadPool(unsigned int threads = 0);
+
+  /**
+   * Destructor.  Finishes all submitted tasks and joins the workers.
+   */ 
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  /**
+   * Queues a task for execution on one of the workers; from inside a task it goes to the calling worker's deque.
+   * @param task - the work to run.
+   */ 
+  void submit( const std::function<void()> & task );
+
+  /**
+   * Blocks until every task submitted so far has finished, including tasks those tasks submit.  Must not be called
+   * from inside a task.
+   */ 
+  void wait();
+
+  /**
+   * Blocks until every task has finished or the time runs out, e.g. to report progress while waiting.
+   * @param milliseconds - the longest time to wait.
+   * @return true if every task has finished, false on timeout.
+   */ 
+  bool wait( unsigned int milliseconds );
+
+  /**
+   * Returns the number of worker threads.
+   * @return the pool size.
+   */ 
+  unsigned int size() const;
+
+  /**
+   * Returns the number of tasks workers have taken from another worker's deque.
+   * @return the steal count.
+   */ 
+  size_t steals() const;
+
+private:
+  struct Queue
+  {
+    std::mutex lock; //held only for a push or a pop, by the owner or a thief
+    std::deque<std::function<void()> > tasks;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<Queue> > queues; //one per worker
+  std::mutex lock;
+  std::condition_variable ready; //signalled when a task is queued or the pool stops
+  std::condition_variable idle; //signalled when pending drops to zero
+  std::atomic<size_t> queued; //in some deque, not yet started
+  std::atomic<size_t> pending; //queued plus running tasks
+  std::atomic<unsigned int> sleeping; //workers waiting on ready
+  std::atomic<unsigned int> next; //deque for the next task submitted from outside the pool
+  std::atomic<size_t> stolen;
+  bool stopping;
+
+  bool take(unsigned int index, std::function<void()> & task);
+  void run(unsigned int index);
+};
+#endif
@@ -0,0 +1,231 @@
+#include "TreeEncryptor.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <memory>
+#include <sys/stat.h>
+
+#include "MappedFile.hpp"
+
+namespace
+{
+	//one file in flight; shared by the tasks of its pieces, the last piece to finish reports it
+	struct Job
+	{
+		std::string path;
+		MappedFile src;
+		MappedFile dst;
+		std::chrono::steady_clock::time_point start;
+		std::atomic<size_t> remaining; //pieces not yet transformed
+	};
+
+	//absolute path without symlinks; a path that does not exist yet is resolved through its parent directory
+	bool resolve(const std::string& path, std::string& real)
+	{
+		char buffer[PATH_MAX];
+		if (::realpath(path.c_str(), buffer))
+		{
+			real = buffer;
+			return true;
+		}
+		size_t slash = path.find_last_of('/');
+		std::string parent = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+		std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+		if (errno != ENOENT || name.empty() || name == "." || name == ".." || !::realpath(parent.c_str(), buffer))
+		{
+			return false;
+		}
+		real = buffer;
+		real += (real == "/") ? name : "/" + name;
+		return true;
+	}
+}
+
+TreeEncryptor::TreeEncryptor(const BlockKernel& K, unsigned int threads, size_t split) : K(K)
+{
+	this->threads = threads;
+	this->split = K.padded(split ? split : 1); //whole blocks, so only the last piece of a file can be padded
+	this->filesDone = 0;
+	this->filesTotal = 0;
+	this->bytesDone = 0;
+	this->bytesTotal = 0;
+	this->failed = false;
+	this->stolen = 0;
+}
+
+bool TreeEncryptor::run(const std::string& from, const std::string& to, const std::function<void(const Progress&)>& progress, unsigned int interval)
+{
+	this->reports.clear();
+	this->filesDone = 0;
+	this->filesTotal = 0;
+	this->bytesDone = 0;
+	this->bytesTotal = 0;
+	this->failed = false;
+	this->stolen = 0;
+	this->start = std::chrono::steady_clock::now();
+	if (this->K.size() == 0)
+	{
+		return false;
+	}
+	//writing into the tree being walked would transform the outputs again, without end
+	std::string source;
+	std::string target;
+	if (!resolve(from, source) || !resolve(to, target))
+	{
+		return false;
+	}
+	std::string inside = (source == "/") ? source : source + "/";
+	if (target == source || target.compare(0, inside.size(), inside) == 0)
+	{
+		return false;
+	}
+
+	ThreadPool pool(this->threads);
+	//the walk runs on this thread while the workers already transform the files it has found
+	if (!this->walk(pool, from, to, ""))
+	{
+		this->failed = true;
+	}
+	while (!pool.wait(interval ? interval : 1))
+	{
+		if (progress)
+		{
+			progress(this->snapshot());
+		}
+	}
+	if (progress)
+	{
+		progress(this->snapshot());
+	}
+	this->stolen = pool.steals();
+	return !this->failed;
+}
+
+const std::vector<TreeEncryptor::FileReport>& TreeEncryptor::files() const
+{
+	return this->reports;
+}
+
+size_t TreeEncryptor::steals() const
+{
+	return this->stolen;
+}
+
+//Private section
+bool TreeEncryptor::walk(ThreadPool& pool, const std::string& from, const std::string& to, const std::string& relative)
+{
+	if (::mkdir(to.c_str(), 0777) != 0 && errno != EEXIST)
+	{
+		return false;
+	}
+	DIR* dir = ::opendir(from.c_str());
+	if (!dir)
+	{
+		return false;
+	}
+	bool ok = true;
+	while (dirent* entry = ::readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+		{
+			continue;
+		}
+		std::string source = from + "/" + name;
+		std::string target = to + "/" + name;
+		std::string path = relative.empty() ? name : relative + "/" + name;
+		struct stat st;
+		if (::lstat(source.c_str(), &st) != 0)
+		{
+			ok = false;
+		}
+		else if (S_ISDIR(st.st_mode)) //symbolic links are neither a directory nor a regular file, so they are skipped
+		{
+			ok = this->walk(pool, source, target, path) && ok;
+		}
+		else if (S_ISREG(st.st_mode))
+		{
+			this->filesTotal.fetch_add(1);
+			this->bytesTotal.fetch_add(static_cast<uint64_t>(st.st_size));
+			pool.submit([this, &pool, source, target, path]() { this->transform(pool, source, target, path); });
+		}
+	}
+	::closedir(dir);
+	return ok;
+}
+
+void TreeEncryptor::transform(ThreadPool& pool, const std::string& from, const std::string& to, const std::string& relative)
+{
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->path = relative;
+	job->start = std::chrono::steady_clock::now();
+
+	//the last piece to finish closes the output and records the file's throughput
+	auto finish = [this](Job& j, bool ok) {
+		size_t bytes = j.src.size();
+		j.src.close();
+		j.dst.close();
+		FileReport r;
+		r.path = j.path;
+		r.bytes = bytes;
+		r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - j.start).count();
+		r.ok = ok;
+		if (!ok)
+		{
+			this->failed = true;
+		}
+		{
+			std::lock_guard<std::mutex> guard(this->reportLock);
+			this->reports.push_back(r);
+		}
+		this->filesDone.fetch_add(1);
+	};
+
+	//a hard link from the destination back into the source must not be truncated under its own mapping
+	if (!job->src.openRead(from) || job->src.sameFile(to) || !job->dst.create(to, this->K.padded(job->src.size())))
+	{
+		finish(*job, false);
+		return;
+	}
+	const char* in = job->src.data();
+	char* out = job->dst.writableData();
+	size_t total = job->src.size();
+	if (total <= this->split)
+	{
+		if (total)
+		{
+			this->K.text(in, total, out);
+		}
+		this->bytesDone.fetch_add(total);
+		finish(*job, true);
+		return;
+	}
+
+	//pieces go to this worker's own deque; idle workers steal them from the front
+	job->remaining = (total + this->split - 1) / this->split;
+	for (size_t off = 0; off < total; off += this->split)
+	{
+		size_t len = (total - off < this->split) ? total - off : this->split;
+		pool.submit([this, job, finish, in, out, off, len]() {
+			this->K.text(in + off, len, out + off);
+			this->bytesDone.fetch_add(len);
+			if (job->remaining.fetch_sub(1) == 1)
+			{
+				finish(*job, true);
+			}
+		});
+	}
+}
+
+TreeEncryptor::Progress TreeEncryptor::snapshot() const
+{
+	Progress p;
+	p.filesDone = this->filesDone.load();
+	p.filesTotal = this->filesTotal.load();
+	p.bytesDone = this->bytesDone.load();
+	p.bytesTotal = this->bytesTotal.load();
+	p.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+	return p;
+}
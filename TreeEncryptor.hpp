@@ -0,0 +1,102 @@
+#ifndef _TREEENCRYPTOR_HPP_
+#define _TREEENCRYPTOR_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BlockKernel.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Encrypts (or decrypts) a whole directory tree into a mirror tree on a work-stealing ThreadPool.  The walk submits one
+ * task per file; a file task maps the file and, if it is larger than the split size, submits one task per block-aligned
+ * piece.  The pieces land on the worker's own deque and idle workers steal them, so a few huge files among many small
+ * ones still keep every core busy until the end.  Each output file is the transform of its input file, exactly as
+ * Hill::encryptFile would write it.  Symbolic links are skipped, so the walk cannot loop, and the destination may not
+ * be the source or lie inside it.
+ */ 
+class TreeEncryptor
+{
+public:
+  /**
+   * Throughput of one finished file.
+   */ 
+  struct FileReport
+  {
+    std::string path; //relative to the source root
+    uint64_t bytes;
+    double seconds; //from mapping the file to the last piece finishing
+    bool ok;
+  };
+
+  /**
+   * A snapshot of the run, passed to the progress callback.
+   */ 
+  struct Progress
+  {
+    uint64_t filesDone;
+    uint64_t filesTotal; //files found so far; final once the walk has finished
+    uint64_t bytesDone;
+    uint64_t bytesTotal;
+    double seconds;
+  };
+
+  /**
+   * Parameterized constructor.
+   * @param K - the prepared key to apply; it must outlive run().
+   * @param threads - number of workers, 0 for one per hardware thread.
+   * @param split - files larger than this many bytes are cut into pieces of about this size.
+   */ 
+  TreeEncryptor(const BlockKernel &K, unsigned int threads = 0, size_t split = 4 << 20);
+
+  /**
+   * Transforms every regular file under from into the same relative path under to, creating directories as needed.
+   * @param from - the source directory.
+   * @param to - the destination directory; it may already exist.
+   * @param progress - if set, called on the calling thread about every interval milliseconds and once at the end.
+   * @param interval - milliseconds between progress calls.
+   * @return true if every file was transformed, false if the key is empty, to is from or inside it, or any file or
+   *         directory failed.
+   */ 
+  bool run( const std::string & from, const std::string & to, const std::function<void(const Progress &)> & progress = nullptr,
+            unsigned int interval = 500 );
+
+  /**
+   * Returns the per-file reports of the last run, in completion order.
+   * @return one report per file.
+   */ 
+  const std::vector<FileReport> & files() const;
+
+  /**
+   * Returns the number of tasks that were stolen by an idle worker in the last run.
+   * @return the steal count.
+   */ 
+  size_t steals() const;
+
+private:
+  const BlockKernel &K;
+  unsigned int threads;
+  size_t split;
+  std::vector<FileReport> reports;
+  std::mutex reportLock;
+  std::atomic<uint64_t> filesDone;
+  std::atomic<uint64_t> filesTotal;
+  std::atomic<uint64_t> bytesDone;
+  std::atomic<uint64_t> bytesTotal;
+  std::atomic<bool> failed;
+  size_t stolen;
+  std::chrono::steady_clock::time_point start;
+
+  //create to, then submit a file task for every regular file under from and recurse into subdirectories
+  bool walk(ThreadPool & pool, const std::string & from, const std::string & to, const std::string & relative);
+  //map one file and transform it, cutting it into pieces submitted to the pool if it is larger than split
+  void transform(ThreadPool & pool, const std::string & from, const std::string & to, const std::string & relative);
+  Progress snapshot() const;
+};
+#endif
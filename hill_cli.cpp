@@ -0,0 +1,532 @@
+//Command-line front end for the Hill cipher: hill encrypt|decrypt|encrypt-tree|decrypt-tree|keygen|inverse|kpa
+//Text goes through raw read/write (Pipeline) or mmap (Hill::encryptFileParallel), never through iostreams.
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Alphabet.hpp"
+#include "ColumnCipher.hpp"
+#include "Hill.hpp"
+#include "KeyFile.hpp"
+#include "Matrix.hpp"
+#include "MappedFile.hpp"
+#include "Pipeline.hpp"
+#include "TreeEncryptor.hpp"
+
+namespace
+{
+	struct Options
+	{
+		std::string key; //matrix file, empty for the default key
+		unsigned int threads = 0; //0 = one per hardware thread
+		size_t chunk = 4 << 20;
+		bool stats = false;
+		std::vector<unsigned int> columns; //fields to transform, 0-based; empty for the whole text
+		char delimiter = ',';
+		bool quotes = true;
+		std::vector<std::string> args; //positional arguments after the subcommand
+	};
+
+	void usage()
+	{
+		std::fputs(
+			"usage: hill encrypt [options] [IN [OUT]]\n"
+			"       hill decrypt [options] [IN [OUT]]\n"
+			"       hill encrypt-tree [options] SRC DST\n"
+			"       hill decrypt-tree [options] SRC DST\n"
+			"       hill keygen N\n"
+			"       hill inverse --key FILE\n"
+			"       hill kpa N PLAIN CIPHER\n"
+			"\n"
+			"IN and OUT default to stdin and stdout ('-' also means the standard stream).  When both are\n"
+			"named files they are memory-mapped and split over --threads; otherwise text is streamed.\n"
+			"With --columns only those fields of each CSV/TSV record are transformed.\n"
+			"The -tree commands transform every file under SRC into the same path under DST.\n"
+			"\n"
+			"options:\n"
+			"  --key FILE         encryption key, n rows of n integers in [0,29) (default: the 2x2 key)\n"
+			"  --threads N        worker threads for file-to-file mode (default: all cores)\n"
+			"  --chunk-size SIZE  bytes per streamed chunk or tree task, with optional K/M/G suffix (default: 4M)\n"
+			"  --columns LIST     transform only these fields, 1-based and comma separated, e.g. 2,5\n"
+			"  --delimiter C      field separator for --columns, a character outside the cipher alphabet\n"
+			"                     or 'tab' (default: ,)\n"
+			"  --no-quotes        do not treat '\"' as CSV quoting, e.g. for TSV\n"
+			"  --stats            print bytes, time and throughput to stderr (for trees: progress and every file)\n"
+			"\n"
+			"kpa reads line i of PLAIN and line i of CIPHER as one known plaintext/ciphertext pair.\n",
+			stderr);
+	}
+
+	//parse a plain decimal number such as 8; strtoul alone would accept blanks, a sign, trailing text or nothing at all
+	bool parseCount(const char* s, unsigned int& value)
+	{
+		if (*s < '0' || *s > '9')
+		{
+			return false;
+		}
+		char* end;
+		errno = 0;
+		unsigned long v = std::strtoul(s, &end, 10);
+		if (*end != '\0' || errno == ERANGE || v > UINT_MAX)
+		{
+			return false;
+		}
+		value = static_cast<unsigned int>(v);
+		return true;
+	}
+
+	//parse a byte count such as 65536, 64K or 4M
+	bool parseSize(const char* s, size_t& value)
+	{
+		if (*s < '0' || *s > '9')
+		{
+			return false;
+		}
+		char* end;
+		errno = 0;
+		unsigned long long v = std::strtoull(s, &end, 10);
+		unsigned int shift = 0;
+		switch (*end)
+		{
+		case 'k': case 'K': shift = 10; ++end; break;
+		case 'm': case 'M': shift = 20; ++end; break;
+		case 'g': case 'G': shift = 30; ++end; break;
+		default: break;
+		}
+		if (*end != '\0' || v == 0 || errno == ERANGE || v > (static_cast<unsigned long long>(SIZE_MAX) >> shift))
+		{
+			return false;
+		}
+		value = static_cast<size_t>(v << shift);
+		return true;
+	}
+
+	//parse a list of 1-based field numbers such as 2,5
+	bool parseColumns(const char* s, std::vector<unsigned int>& columns)
+	{
+		for (;;)
+		{
+			if (*s < '0' || *s > '9')
+			{
+				return false;
+			}
+			char* end;
+			errno = 0;
+			unsigned long v = std::strtoul(s, &end, 10);
+			if (errno == ERANGE || v == 0 || v > ColumnCipher::MAX_COLUMNS)
+			{
+				return false;
+			}
+			columns.push_back(static_cast<unsigned int>(v - 1));
+			if (*end == '\0')
+			{
+				return true;
+			}
+			if (*end != ',')
+			{
+				return false;
+			}
+			s = end + 1;
+		}
+	}
+
+	bool parseOptions(int argc, char** argv, Options& opt)
+	{
+		for (int i = 2; i < argc; ++i)
+		{
+			std::string a = argv[i];
+			if ((a == "--key" || a == "--threads" || a == "--chunk-size" || a == "--columns" || a == "--delimiter") && i + 1 >= argc)
+			{
+				std::fprintf(stderr, "hill: %s needs a value\n", a.c_str());
+				return false;
+			}
+			if (a == "--key")
+			{
+				opt.key = argv[++i];
+			}
+			else if (a == "--threads")
+			{
+				if (!parseCount(argv[++i], opt.threads))
+				{
+					std::fprintf(stderr, "hill: bad thread count '%s'\n", argv[i]);
+					return false;
+				}
+			}
+			else if (a == "--chunk-size")
+			{
+				if (!parseSize(argv[++i], opt.chunk))
+				{
+					std::fprintf(stderr, "hill: bad chunk size '%s'\n", argv[i]);
+					return false;
+				}
+			}
+			else if (a == "--columns")
+			{
+				if (!parseColumns(argv[++i], opt.columns))
+				{
+					std::fprintf(stderr, "hill: bad column list '%s'\n", argv[i]);
+					return false;
+				}
+			}
+			else if (a == "--delimiter")
+			{
+				std::string d = argv[++i];
+				if (d == "tab" || d == "\\t")
+				{
+					d = "\t";
+				}
+				//ciphertext uses the whole alphabet, so such a delimiter would split encrypted fields on decryption
+				if (d.size() != 1 || d[0] == '\n' || d[0] == '"' || Alphabet::contains(d[0]))
+				{
+					std::fprintf(stderr, "hill: bad delimiter '%s'\n", argv[i]);
+					return false;
+				}
+				opt.delimiter = d[0];
+			}
+			else if (a == "--no-quotes")
+			{
+				opt.quotes = false;
+			}
+			else if (a == "--stats")
+			{
+				opt.stats = true;
+			}
+			else if (a.size() > 1 && a[0] == '-' && a != "-")
+			{
+				std::fprintf(stderr, "hill: unknown option '%s'\n", a.c_str());
+				return false;
+			}
+			else
+			{
+				opt.args.push_back(a);
+			}
+		}
+		return true;
+	}
+
+	bool readAll(const std::string& path, std::string& text)
+	{
+		MappedFile f;
+		if (!f.openRead(path))
+		{
+			std::fprintf(stderr, "hill: cannot read '%s'\n", path.c_str());
+			return false;
+		}
+		text.assign(f.data() ? f.data() : "", f.size());
+		return true;
+	}
+
+	void printKey(const Matrix& K)
+	{
+		std::fputs(KeyFile::format(K).c_str(), stdout);
+	}
+
+	//the --key matrix, or the default key when none was given
+	bool loadKey(const Options& opt, Matrix& K)
+	{
+		if (opt.key.empty())
+		{
+			K = Hill().getE();
+			return true;
+		}
+		if (!KeyFile::read(opt.key, K))
+		{
+			std::fprintf(stderr, "hill: '%s' is not a key file (n rows of n integers, n >= 2)\n", opt.key.c_str());
+			return false;
+		}
+		Hill H(K, true);
+		if (H.getE().size(1) == 0 || H.getD().size(1) == 0)
+		{
+			std::fprintf(stderr, "hill: key in '%s' is not invertible mod 29\n", opt.key.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool isStream(const std::string& name)
+	{
+		return name.empty() || name == "-";
+	}
+
+	//true if path names the file open on fd (same device and inode), e.g. through a hard link or /dev/stdin
+	bool sameFile(int fd, const std::string& path)
+	{
+		struct stat mine;
+		struct stat other;
+		if (fstat(fd, &mine) != 0 || ::stat(path.c_str(), &other) != 0)
+		{
+			return false;
+		}
+		return mine.st_dev == other.st_dev && mine.st_ino == other.st_ino;
+	}
+
+	int transform(const Options& opt, bool encrypt)
+	{
+		Matrix key;
+		if (!loadKey(opt, key))
+		{
+			return 1;
+		}
+		Hill H(key, true);
+		if (opt.args.size() > 2)
+		{
+			usage();
+			return 2;
+		}
+		std::string in = opt.args.size() > 0 ? opt.args[0] : "";
+		std::string out = opt.args.size() > 1 ? opt.args[1] : "";
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t bytes = 0;
+		bool ok;
+		//pipes, devices and /dev/stdout cannot be mapped, so only regular files (or a new output) take the mapped path
+		struct stat inStat;
+		struct stat outStat;
+		bool mapped = !isStream(in) && !isStream(out) && opt.columns.empty() &&
+			::stat(in.c_str(), &inStat) == 0 && S_ISREG(inStat.st_mode) &&
+			(::stat(out.c_str(), &outStat) == 0 ? S_ISREG(outStat.st_mode) : errno == ENOENT);
+		if (mapped)
+		{
+			bytes = static_cast<size_t>(inStat.st_size);
+			ok = encrypt ? H.encryptFileParallel(in, out, opt.threads) : H.decryptFileParallel(in, out, opt.threads);
+		}
+		else
+		{
+			int fin = isStream(in) ? 0 : ::open(in.c_str(), O_RDONLY);
+			if (fin < 0)
+			{
+				std::fprintf(stderr, "hill: cannot open '%s'\n", in.c_str());
+				return 1;
+			}
+			//the output is truncated before anything is read, so writing over the input would lose it
+			if (!isStream(out) && sameFile(fin, out))
+			{
+				std::fprintf(stderr, "hill: '%s' is both input and output\n", out.c_str());
+				if (fin != 0)
+				{
+					::close(fin);
+				}
+				return 1;
+			}
+			int fout = isStream(out) ? 1 : ::open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fout < 0)
+			{
+				std::fprintf(stderr, "hill: cannot open '%s'\n", out.c_str());
+				if (fin != 0)
+				{
+					::close(fin);
+				}
+				return 1;
+			}
+			BlockKernel K(encrypt ? H.getE() : H.getD());
+			if (opt.columns.empty())
+			{
+				Pipeline pipe(K, opt.chunk);
+				ok = pipe.run(fin, fout);
+				bytes = pipe.consumed();
+			}
+			else
+			{
+				ColumnCipher fields(K, opt.columns, opt.delimiter, opt.quotes, opt.threads);
+				ok = fields.run(fin, fout, opt.chunk);
+				bytes = fields.consumed();
+			}
+			if (fin != 0)
+			{
+				::close(fin);
+			}
+			if (fout != 1 && ::close(fout) != 0)
+			{
+				ok = false;
+			}
+		}
+		if (!ok)
+		{
+			std::fprintf(stderr, "hill: %s failed\n", encrypt ? "encryption" : "decryption");
+			return 1;
+		}
+
+		if (opt.stats)
+		{
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::fprintf(stderr, "hill: %s %zu bytes in %.3f s (%.1f MB/s)\n", encrypt ? "encrypted" : "decrypted",
+				bytes, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+		}
+		return 0;
+	}
+
+	int transformTree(const Options& opt, bool encrypt)
+	{
+		Matrix key;
+		if (!loadKey(opt, key))
+		{
+			return 1;
+		}
+		if (opt.args.size() != 2)
+		{
+			usage();
+			return 2;
+		}
+		Hill H(key, true);
+		BlockKernel K(encrypt ? H.getE() : H.getD());
+		TreeEncryptor tree(K, opt.threads, opt.chunk);
+		std::function<void(const TreeEncryptor::Progress&)> progress;
+		if (opt.stats)
+		{
+			progress = [](const TreeEncryptor::Progress& p) {
+				std::fprintf(stderr, "hill: %llu/%llu files, %llu/%llu bytes, %.1f s\n",
+					static_cast<unsigned long long>(p.filesDone), static_cast<unsigned long long>(p.filesTotal),
+					static_cast<unsigned long long>(p.bytesDone), static_cast<unsigned long long>(p.bytesTotal), p.seconds);
+			};
+		}
+		bool ok = tree.run(opt.args[0], opt.args[1], progress);
+
+		const std::vector<TreeEncryptor::FileReport>& files = tree.files();
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			const TreeEncryptor::FileReport& f = files[i];
+			if (!f.ok)
+			{
+				std::fprintf(stderr, "hill: cannot transform '%s'\n", f.path.c_str());
+			}
+			else if (opt.stats)
+			{
+				std::fprintf(stderr, "hill: %s %llu bytes in %.3f s (%.1f MB/s)\n", f.path.c_str(),
+					static_cast<unsigned long long>(f.bytes), f.seconds, f.seconds > 0 ? f.bytes / f.seconds / 1e6 : 0.0);
+			}
+		}
+		if (opt.stats)
+		{
+			std::fprintf(stderr, "hill: %zu tasks stolen\n", tree.steals());
+		}
+		if (!ok)
+		{
+			std::fprintf(stderr, "hill: %s of '%s' failed\n", encrypt ? "encryption" : "decryption", opt.args[0].c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	int keygen(const Options& opt)
+	{
+		unsigned int n = 0;
+		if (opt.args.size() != 1 || !parseCount(opt.args[0].c_str(), n) || n < 2)
+		{
+			usage();
+			return 2;
+		}
+		std::random_device seed;
+		printKey(KeyFile::random(n, seed()));
+		return 0;
+	}
+
+	int inverse(const Options& opt)
+	{
+		Matrix K;
+		if (opt.key.empty() || !opt.args.empty())
+		{
+			usage();
+			return 2;
+		}
+		if (!loadKey(opt, K))
+		{
+			return 1;
+		}
+		Hill H(K, true);
+		printKey(H.getD());
+		return 0;
+	}
+
+	void splitLines(const std::string& text, std::vector<std::string>& lines)
+	{
+		size_t start = 0;
+		while (start < text.size())
+		{
+			size_t stop = text.find('\n', start);
+			if (stop == std::string::npos)
+			{
+				stop = text.size();
+			}
+			lines.push_back(text.substr(start, stop - start));
+			start = stop + 1;
+		}
+	}
+
+	int kpa(const Options& opt)
+	{
+		if (opt.args.size() != 3)
+		{
+			usage();
+			return 2;
+		}
+		unsigned int n = 0;
+		if (!parseCount(opt.args[0].c_str(), n) || n < 2)
+		{
+			usage();
+			return 2;
+		}
+		std::string plain;
+		std::string cipher;
+		if (!readAll(opt.args[1], plain) || !readAll(opt.args[2], cipher))
+		{
+			return 1;
+		}
+		std::vector<std::string> P;
+		std::vector<std::string> C;
+		splitLines(plain, P);
+		splitLines(cipher, C);
+		Hill H;
+		if (!H.kpa(P, C, n))
+		{
+			std::fprintf(stderr, "hill: the pairs do not determine a %ux%u key\n", n, n);
+			return 1;
+		}
+		printKey(H.getE());
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	if (argc < 2 || !parseOptions(argc, argv, opt))
+	{
+		usage();
+		return 2;
+	}
+	std::string command = argv[1];
+	if (command == "encrypt" || command == "decrypt")
+	{
+		return transform(opt, command == "encrypt");
+	}
+	if (command == "encrypt-tree" || command == "decrypt-tree")
+	{
+		return transformTree(opt, command == "encrypt-tree");
+	}
+	if (command == "keygen")
+	{
+		return keygen(opt);
+	}
+	if (command == "inverse")
+	{
+		return inverse(opt);
+	}
+	if (command == "kpa")
+	{
+		return kpa(opt);
+	}
+	usage();
+	return 2;
+}
@@ -0,0 +1,376 @@
+//Load generator for the Hill cipher: hill-load [options]
+//Drives the library API, the epoll daemon or the shared-memory service from several threads, closed loop or at a
+//fixed open-loop rate, and prints one machine-readable result line per rate.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Daemon.hpp"
+#include "DaemonClient.hpp"
+#include "Hill.hpp"
+#include "KeyFile.hpp"
+#include "LatencyHistogram.hpp"
+#include "ShmClient.hpp"
+#include "ShmServer.hpp"
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration SPIN = std::chrono::microseconds(100); //open loop: busy-wait this long before each send
+
+	struct Options
+	{
+		std::string target = "api"; //api, daemon or shm
+		std::string endpoint; //socket path or shm name of a running service; empty starts one in-process
+		std::string op = "encrypt"; //encrypt, decrypt or mixed
+		std::string sizes = "fixed:32";
+		unsigned int keySize = 2;
+		unsigned int concurrency = 1;
+		std::vector<double> rates; //requests per second over all threads; 0 = closed loop
+		double duration = 5;
+		double warmup = 1;
+		bool csv = false;
+	};
+
+	//message lengths: fixed:N, uniform:LO:HI or exp:MEAN
+	struct Sizes
+	{
+		char kind;
+		double a;
+		double b;
+
+		bool parse(const std::string& spec)
+		{
+			std::string name = spec.substr(0, spec.find(':'));
+			this->a = 0;
+			this->b = 0;
+			if (std::sscanf(spec.c_str() + name.size(), ":%lf:%lf", &this->a, &this->b) < 1 || this->a < 1)
+			{
+				return false;
+			}
+			this->kind = name == "fixed" ? 'f' : name == "uniform" ? 'u' : name == "exp" ? 'e' : 0;
+			return this->kind && (this->kind != 'u' || this->b >= this->a);
+		}
+
+		size_t draw(std::mt19937& rng) const
+		{
+			if (this->kind == 'u')
+			{
+				return std::uniform_int_distribution<size_t>(static_cast<size_t>(this->a), static_cast<size_t>(this->b))(rng);
+			}
+			if (this->kind == 'e')
+			{
+				return 1 + static_cast<size_t>(std::exponential_distribution<double>(1.0 / this->a)(rng));
+			}
+			return static_cast<size_t>(this->a);
+		}
+	};
+
+	//one connection or handle per thread; send() performs a full round trip
+	struct Driver
+	{
+		virtual ~Driver() {}
+		virtual bool send(uint8_t op, const std::string& text, std::string& result) = 0;
+	};
+
+	struct ApiDriver : Driver
+	{
+		Hill& H;
+		explicit ApiDriver(Hill& H) : H(H) {}
+		bool send(uint8_t op, const std::string& text, std::string& result)
+		{
+			result = (op == Frame::ENCRYPT) ? this->H.encrypt(text) : this->H.decrypt(text);
+			return !result.empty();
+		}
+	};
+
+	struct DaemonDriver : Driver
+	{
+		DaemonClient client;
+		bool send(uint8_t op, const std::string& text, std::string& result)
+		{
+			return this->client.call(op, text, result);
+		}
+	};
+
+	struct ShmDriver : Driver
+	{
+		ShmClient client;
+		bool send(uint8_t op, const std::string& text, std::string& result)
+		{
+			return this->client.call(op, text, result);
+		}
+	};
+
+	struct Result
+	{
+		LatencyHistogram latency;
+		uint64_t requests = 0;
+		uint64_t errors = 0;
+		uint64_t bytes = 0;
+	};
+
+	void usage()
+	{
+		std::fputs(
+			"usage: hill-load [options]\n"
+			"  --target api|daemon|shm  path to drive (default: api)\n"
+			"  --endpoint NAME          socket path (daemon) or shm name (shm) of a running service;\n"
+			"                           without it a service is started in-process\n"
+			"  --op encrypt|decrypt|mixed\n"
+			"  --sizes SPEC             fixed:N, uniform:LO:HI or exp:MEAN characters (default: fixed:32)\n"
+			"  --key-size N             block size of the random key used in-process (default: 2)\n"
+			"  --concurrency N          client threads, one request in flight each (default: 1)\n"
+			"  --rate R[,R...]          open loop at R requests/s in total, one result per rate;\n"
+			"                           0 or absent runs closed loop\n"
+			"  --duration S             measured seconds per rate (default: 5)\n"
+			"  --warmup S               unmeasured seconds before each rate (default: 1)\n"
+			"  --csv                    CSV instead of one JSON object per line\n"
+			"\n"
+			"Open-loop latencies are measured from each request's scheduled send time, so a stalled service is charged\n"
+			"for the requests it delayed (no coordinated omission).\n",
+			stderr);
+	}
+
+	bool parseOptions(int argc, char** argv, Options& opt)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string a = argv[i];
+			if (a == "--csv")
+			{
+				opt.csv = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+			{
+				return false;
+			}
+			std::string v = argv[++i];
+			if (a == "--target") opt.target = v;
+			else if (a == "--endpoint") opt.endpoint = v;
+			else if (a == "--op") opt.op = v;
+			else if (a == "--sizes") opt.sizes = v;
+			else if (a == "--key-size") opt.keySize = static_cast<unsigned int>(std::strtoul(v.c_str(), nullptr, 10));
+			else if (a == "--concurrency") opt.concurrency = static_cast<unsigned int>(std::strtoul(v.c_str(), nullptr, 10));
+			else if (a == "--duration") opt.duration = std::strtod(v.c_str(), nullptr);
+			else if (a == "--warmup") opt.warmup = std::strtod(v.c_str(), nullptr);
+			else if (a == "--rate")
+			{
+				std::stringstream list(v);
+				std::string r;
+				while (std::getline(list, r, ','))
+				{
+					opt.rates.push_back(std::strtod(r.c_str(), nullptr));
+				}
+			}
+			else
+			{
+				return false;
+			}
+		}
+		if (opt.rates.empty())
+		{
+			opt.rates.push_back(0);
+		}
+		return (opt.target == "api" || opt.target == "daemon" || opt.target == "shm")
+			&& (opt.op == "encrypt" || opt.op == "decrypt" || opt.op == "mixed")
+			&& opt.keySize >= 2 && opt.concurrency >= 1 && opt.duration > 0 && opt.warmup >= 0;
+	}
+
+	//warm up, then measure; in open loop a thread sends on its own fixed schedule and charges late sends to latency
+	void drive(Driver& d, const Options& opt, const Sizes& sizes, double rate, unsigned int seed, Result& out)
+	{
+		std::mt19937 rng(seed);
+		std::vector<std::string> pool(256);
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ.? ";
+		for (size_t m = 0; m < pool.size(); ++m)
+		{
+			pool[m].resize(sizes.draw(rng));
+			for (size_t c = 0; c < pool[m].size(); ++c)
+			{
+				pool[m][c] = alphabet[rng() % 29];
+			}
+		}
+
+		Clock::duration interval = Clock::duration::zero();
+		if (rate > 0)
+		{
+			interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.concurrency / rate));
+		}
+		Clock::time_point start = Clock::now();
+		Clock::time_point measure = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.warmup));
+		Clock::time_point stop = measure + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.duration));
+		Clock::time_point next = start;
+		std::string result;
+		for (uint64_t i = 0; ; ++i)
+		{
+			Clock::time_point now = Clock::now();
+			if (rate > 0)
+			{
+				//sleep_until wakes tens of microseconds late, which would be charged to the service; spin the last stretch
+				if (next - now > SPIN)
+				{
+					std::this_thread::sleep_until(next - SPIN);
+				}
+				while (Clock::now() < next)
+				{
+				}
+			}
+			else
+			{
+				next = now;
+			}
+			if (next >= stop)
+			{
+				break;
+			}
+			const std::string& text = pool[i % pool.size()];
+			uint8_t op = (opt.op == "decrypt" || (opt.op == "mixed" && (i & 1))) ? Frame::DECRYPT : Frame::ENCRYPT;
+			bool ok = d.send(op, text, result);
+			Clock::time_point done = Clock::now();
+			if (next >= measure)
+			{
+				out.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(done - next).count()));
+				++out.requests;
+				out.errors += ok ? 0 : 1;
+				out.bytes += text.size();
+			}
+			next += interval;
+		}
+	}
+
+	void report(const Options& opt, double rate, const Result& r, bool header)
+	{
+		const LatencyHistogram& h = r.latency;
+		double rps = r.requests / opt.duration;
+		double mbps = r.bytes / opt.duration / 1e6;
+		if (opt.csv)
+		{
+			if (header)
+			{
+				std::printf("target,op,sizes,key_size,concurrency,rate,requests,errors,throughput_rps,throughput_mbps,"
+					"min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,p9999_ns,max_ns\n");
+			}
+			std::printf("%s,%s,%s,%u,%u,%.0f,%llu,%llu,%.1f,%.3f,%llu,%.0f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+				opt.target.c_str(), opt.op.c_str(), opt.sizes.c_str(), opt.keySize, opt.concurrency, rate,
+				(unsigned long long)r.requests, (unsigned long long)r.errors, rps, mbps,
+				(unsigned long long)h.min(), h.mean(), (unsigned long long)h.percentile(50), (unsigned long long)h.percentile(90),
+				(unsigned long long)h.percentile(99), (unsigned long long)h.percentile(99.9), (unsigned long long)h.percentile(99.99),
+				(unsigned long long)h.max());
+		}
+		else
+		{
+			std::printf("{\"target\":\"%s\",\"op\":\"%s\",\"sizes\":\"%s\",\"key_size\":%u,\"concurrency\":%u,\"rate\":%.0f,"
+				"\"requests\":%llu,\"errors\":%llu,\"throughput_rps\":%.1f,\"throughput_mbps\":%.3f,"
+				"\"latency_ns\":{\"min\":%llu,\"mean\":%.0f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"p9999\":%llu,\"max\":%llu}}\n",
+				opt.target.c_str(), opt.op.c_str(), opt.sizes.c_str(), opt.keySize, opt.concurrency, rate,
+				(unsigned long long)r.requests, (unsigned long long)r.errors, rps, mbps,
+				(unsigned long long)h.min(), h.mean(), (unsigned long long)h.percentile(50), (unsigned long long)h.percentile(90),
+				(unsigned long long)h.percentile(99), (unsigned long long)h.percentile(99.9), (unsigned long long)h.percentile(99.99),
+				(unsigned long long)h.max());
+		}
+		std::fflush(stdout);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	Sizes sizes;
+	if (!parseOptions(argc, argv, opt) || !sizes.parse(opt.sizes))
+	{
+		usage();
+		return 2;
+	}
+
+	//an in-process service gets its own random key of the requested size
+	Hill H(KeyFile::random(opt.keySize, 29), true);
+	std::unique_ptr<Daemon> daemon;
+	std::unique_ptr<ShmServer> shm;
+	std::thread server;
+	std::string endpoint = opt.endpoint;
+	if (endpoint.empty() && opt.target == "daemon")
+	{
+		endpoint = "/tmp/hill-load-" + std::to_string(::getpid()) + ".sock";
+		daemon.reset(new Daemon(H));
+		if (!daemon->listen(endpoint))
+		{
+			std::fprintf(stderr, "hill-load: cannot listen on '%s'\n", endpoint.c_str());
+			return 1;
+		}
+		server = std::thread([&daemon]() { daemon->run(); });
+	}
+	if (endpoint.empty() && opt.target == "shm")
+	{
+		endpoint = "/hill-load-" + std::to_string(::getpid());
+		shm.reset(new ShmServer(H));
+		if (!shm->start(endpoint))
+		{
+			std::fprintf(stderr, "hill-load: cannot create shared memory '%s'\n", endpoint.c_str());
+			return 1;
+		}
+	}
+
+	int status = 0;
+	for (size_t r = 0; r < opt.rates.size() && status == 0; ++r)
+	{
+		std::vector<std::unique_ptr<Driver> > drivers;
+		for (unsigned int t = 0; t < opt.concurrency && status == 0; ++t)
+		{
+			if (opt.target == "api")
+			{
+				drivers.push_back(std::unique_ptr<Driver>(new ApiDriver(H)));
+			}
+			else if (opt.target == "daemon")
+			{
+				DaemonDriver* d = new DaemonDriver;
+				drivers.push_back(std::unique_ptr<Driver>(d));
+				status = d->client.connect(endpoint) ? 0 : 1;
+			}
+			else
+			{
+				ShmDriver* d = new ShmDriver;
+				drivers.push_back(std::unique_ptr<Driver>(d));
+				status = d->client.attach(endpoint) ? 0 : 1;
+			}
+		}
+		if (status)
+		{
+			std::fprintf(stderr, "hill-load: cannot connect to '%s'\n", endpoint.c_str());
+			break;
+		}
+
+		std::vector<Result> results(opt.concurrency);
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < opt.concurrency; ++t)
+		{
+			threads.push_back(std::thread(drive, std::ref(*drivers[t]), std::cref(opt), std::cref(sizes), opt.rates[r], 1000 + t, std::ref(results[t])));
+		}
+		Result total;
+		for (unsigned int t = 0; t < opt.concurrency; ++t)
+		{
+			threads[t].join();
+			total.latency.merge(results[t].latency);
+			total.requests += results[t].requests;
+			total.errors += results[t].errors;
+			total.bytes += results[t].bytes;
+		}
+		report(opt, opt.rates[r], total, r == 0);
+	}
+
+	if (daemon)
+	{
+		daemon->stop();
+		server.join();
+	}
+	return status;
+}
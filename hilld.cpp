@@ -0,0 +1,119 @@
+//Encryption daemon: hilld SOCKET [--key FILE] [--batch N]
+//Serves Frame requests on a Unix domain socket until SIGINT or SIGTERM.
+
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Daemon.hpp"
+#include "Hill.hpp"
+#include "KeyFile.hpp"
+#include "Matrix.hpp"
+
+namespace
+{
+	Daemon* running = nullptr;
+
+	//Daemon::stop only writes to an eventfd, which is safe in a signal handler
+	void onSignal(int)
+	{
+		if (running)
+		{
+			running->stop();
+		}
+	}
+
+	//a whole decimal number that fits in unsigned int, like hill's --threads; no sign, spaces or trailing text
+	bool parseCount(const char* s, unsigned int& value)
+	{
+		if (*s < '0' || *s > '9')
+		{
+			return false;
+		}
+		char* end;
+		errno = 0;
+		unsigned long v = std::strtoul(s, &end, 10);
+		if (*end != '\0' || errno == ERANGE || v > UINT_MAX)
+		{
+			return false;
+		}
+		value = static_cast<unsigned int>(v);
+		return true;
+	}
+
+	void usage()
+	{
+		std::fputs(
+			"usage: hilld SOCKET [--key FILE] [--batch N]\n"
+			"  --key FILE  encryption key, n rows of n integers in [0,29) (default: the 2x2 key)\n"
+			"  --batch N   most requests coalesced into one kernel pass (default: 1024)\n",
+			stderr);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string socket;
+	std::string key;
+	unsigned int batch = 1024;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string a = argv[i];
+		if ((a == "--key" || a == "--batch") && i + 1 < argc)
+		{
+			if (a == "--key")
+			{
+				key = argv[++i];
+			}
+			else if (!parseCount(argv[++i], batch) || batch == 0)
+			{
+				std::fprintf(stderr, "hilld: bad batch size '%s'\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (socket.empty() && !a.empty() && a[0] != '-')
+		{
+			socket = a;
+		}
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+	if (socket.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	Matrix K = Hill().getE();
+	if (!key.empty() && !KeyFile::read(key, K))
+	{
+		std::fprintf(stderr, "hilld: '%s' is not a key file (n rows of n integers, n >= 2)\n", key.c_str());
+		return 1;
+	}
+	Hill H(K, true);
+	if (H.getE().size(1) == 0 || H.getD().size(1) == 0)
+	{
+		std::fprintf(stderr, "hilld: key is not invertible mod 29\n");
+		return 1;
+	}
+
+	Daemon d(H, batch);
+	if (!d.listen(socket))
+	{
+		std::fprintf(stderr, "hilld: cannot listen on '%s'\n", socket.c_str());
+		return 1;
+	}
+	running = &d;
+	std::signal(SIGINT, onSignal);
+	std::signal(SIGTERM, onSignal);
+	std::signal(SIGPIPE, SIG_IGN);
+	bool ok = d.run();
+	running = nullptr;
+	return ok ? 0 : 1;
+}
@@ -1,6 +1,29 @@
 #include "catch.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include "Hill.hpp"
 #include "Matrix.hpp"
+#include "ColumnCipher.hpp"
+#include "Container.hpp"
+#include "Daemon.hpp"
+#include "KeyFile.hpp"
+#include "KeyRegistry.hpp"
+#include "LatencyHistogram.hpp"
+#include "DaemonClient.hpp"
+#include "EncryptedLog.hpp"
+#include "SharedKey.hpp"
+#include "ShmClient.hpp"
+#include "ThreadPool.hpp"
+#include "PackedFormat.hpp"
+#include "TreeEncryptor.hpp"
 
 TEST_CASE( "default constructor", "[Hill]" )
 {
@@ -38,3 +61,1333 @@ TEST_CASE( "default constructor", "[Hill]" )
   REQUIRE(x.get(1, 1) == 28);*/
 
 }
+
+TEST_CASE( "column tables for large keys", "[Hill]" )
+{
+  INFO("Hint: encrypt with a 4-by-4 to 16-by-16 key must match the plain E.mult path");
+  std::string P = "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG? yes.";
+
+  for (unsigned int n = 4; n <= 16; ++n)
+  {
+    // unit upper triangular, so the determinant is 1
+    std::vector<int> vec(n * n);
+    for (unsigned int j = 0; j < n; ++j)
+      for (unsigned int k = 0; k <= j; ++k)
+        vec[j * n + k] = (k == j) ? 1 : (3 * k + 5 * j + 1) % 29;
+    Matrix E(vec, n, n);
+
+    Hill H;
+    REQUIRE(H.setE(E));
+    std::string C = H.encrypt(P);
+    REQUIRE(C.length() == (P.length() + n - 1) / n * n);
+    REQUIRE(C == H.encrypt(P, E));
+  }
+}
+
+TEST_CASE( "vectorized block kernels", "[Hill]" )
+{
+  INFO("Hint: every instruction set level must give the same blocks as K*P mod 29");
+  const size_t blocks = 203; // not a multiple of any vector width, so the scalar tail runs too
+
+  for (unsigned int n = 2; n <= 20; ++n)
+  {
+    std::vector<int> vec(n * n);
+    for (unsigned int i = 0; i < n * n; ++i)
+      vec[i] = (7 * i * i + 3 * i + 11) % 29;
+    Matrix K(vec, n, n);
+
+    std::vector<uint8_t> in(n * blocks);
+    for (size_t i = 0; i < in.size(); ++i)
+      in[i] = (i * 13 + i / 7) % 29;
+
+    std::vector<uint8_t> expect(n * blocks);
+    for (size_t b = 0; b < blocks; ++b)
+      for (unsigned int k = 0; k < n; ++k)
+      {
+        int acc = 0;
+        for (unsigned int i = 0; i < n; ++i)
+          acc += K.get(k, i) * in[i * blocks + b];
+        expect[k * blocks + b] = acc % 29;
+      }
+
+    for (int isa = BlockKernel::SCALAR; isa <= BlockKernel::AVX512; ++isa)
+    {
+      BlockKernel BK(K, static_cast<BlockKernel::Isa>(isa));
+      std::vector<uint8_t> out(in);
+      BK.transform(&out[0], &out[0], blocks, blocks);
+      REQUIRE(out == expect);
+    }
+  }
+
+  Hill H;
+  std::string P(1000, 'X');
+  for (size_t i = 0; i < P.length(); ++i)
+    P[i] = "ABCXYZ.? abcxyz\n"[i % 16];
+  REQUIRE(H.encrypt(P) == H.encrypt(P, H.getE()));
+  REQUIRE(H.decrypt(H.encrypt(P)) == H.decrypt(H.encrypt(P), H.getD()));
+}
+
+TEST_CASE( "batch encryption", "[Hill]" )
+{
+  INFO("Hint: encryptBatch must give the same ciphertexts as one encrypt call per message");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+  REQUIRE(H.setD(H.inv_mod(E)));
+
+  std::vector<std::string> P;
+  for (unsigned int i = 0; i < 3000; ++i)
+    P.push_back(std::string(i % 37, "HELLO WORLD?."[i % 13]));
+
+  std::string out;
+  std::vector<size_t> offsets;
+  H.encryptBatch(P, out, offsets);
+  REQUIRE(offsets.size() == P.size() + 1);
+
+  std::vector<std::string> C;
+  for (unsigned int i = 0; i < P.size(); ++i)
+  {
+    C.push_back(out.substr(offsets[i], offsets[i + 1] - offsets[i]));
+    REQUIRE(C[i] == H.encrypt(P[i]));
+  }
+
+  std::string back;
+  H.decryptBatch(C, back, offsets);
+  for (unsigned int i = 0; i < C.size(); ++i)
+    REQUIRE(back.substr(offsets[i], offsets[i + 1] - offsets[i]) == H.decrypt(C[i]));
+}
+
+TEST_CASE( "fused text kernel", "[Hill]" )
+{
+  INFO("Hint: BlockKernel::text must equal n2let(E*l2num(P)) for every length and key size");
+  unsigned int sizes[] = {2, 5, 16, 65, 70};
+  for (unsigned int n : sizes)
+  {
+    std::vector<int> vec(n * n);
+    for (unsigned int j = 0; j < n; ++j)
+      for (unsigned int k = 0; k <= j; ++k)
+        vec[j * n + k] = (k == j) ? 1 : (2 * k + 7 * j) % 29;
+    Matrix E(vec, n, n);
+    Hill H;
+    REQUIRE(H.setE(E));
+    BlockKernel BK(E);
+
+    size_t lengths[] = {1, n - 1, n, BlockKernel::TILE * n + 3};
+    for (size_t len : lengths)
+    {
+      std::string P(len, ' ');
+      for (size_t i = 0; i < len; ++i)
+        P[i] = "Attack at dawn? NOW.\t"[i % 21];
+      std::string C(BK.padded(len), '\0');
+      BK.text(P.data(), len, &C[0]);
+      REQUIRE(C == H.encrypt(P, E));
+      REQUIRE(C == H.encrypt(P));
+    }
+  }
+}
+
+TEST_CASE( "stream encryption", "[Hill]" )
+{
+  INFO("Hint: encryptStream must match encrypt for any chunk size, padding only at the end");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+  REQUIRE(H.setD(H.inv_mod(E)));
+
+  std::string P;
+  for (unsigned int i = 0; i < 10007; ++i)
+    P += "STREAMING TEXT?."[i % 16];
+
+  size_t chunks[] = {1, 2, 3, 4, 100, 4096, 1 << 20};
+  for (size_t chunk : chunks)
+  {
+    std::istringstream in(P);
+    std::ostringstream out;
+    REQUIRE(H.encryptStream(in, out, chunk));
+    REQUIRE(out.str() == H.encrypt(P));
+
+    std::istringstream cin(out.str());
+    std::ostringstream back;
+    REQUIRE(H.decryptStream(cin, back, chunk));
+    REQUIRE(back.str() == H.decrypt(out.str()));
+  }
+
+  std::istringstream empty("");
+  std::ostringstream none;
+  REQUIRE(H.encryptStream(empty, none));
+  REQUIRE(none.str().empty());
+}
+
+TEST_CASE( "memory-mapped file encryption", "[Hill]" )
+{
+  INFO("Hint: encryptFile must write exactly encrypt(file contents)");
+  Hill H;
+  std::string P;
+  for (unsigned int i = 0; i < 100001; ++i)
+    P += "MAPPED FILE?."[i % 13];
+  {
+    std::ofstream f("hill_mmap_plain.txt", std::ios::binary);
+    f << P;
+  }
+
+  REQUIRE(H.encryptFile("hill_mmap_plain.txt", "hill_mmap_cipher.txt"));
+  std::ifstream c("hill_mmap_cipher.txt", std::ios::binary);
+  std::string C((std::istreambuf_iterator<char>(c)), std::istreambuf_iterator<char>());
+  REQUIRE(C == H.encrypt(P));
+
+  REQUIRE(H.decryptFile("hill_mmap_cipher.txt", "hill_mmap_back.txt"));
+  std::ifstream b("hill_mmap_back.txt", std::ios::binary);
+  std::string B((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+  REQUIRE(B == H.decrypt(C));
+
+  REQUIRE_FALSE(H.encryptFile("hill_mmap_missing.txt", "hill_mmap_out.txt"));
+  //a pipe has no size to map, so it must be refused rather than read as an empty file
+  int fds[2];
+  REQUIRE(::pipe(fds) == 0);
+  REQUIRE(::write(fds[1], "AB", 2) == 2);
+  REQUIRE_FALSE(H.encryptFile("/dev/fd/" + std::to_string(fds[0]), "hill_mmap_out.txt"));
+  ::close(fds[0]);
+  ::close(fds[1]);
+  std::remove("hill_mmap_out.txt");
+  std::remove("hill_mmap_plain.txt");
+  std::remove("hill_mmap_cipher.txt");
+  std::remove("hill_mmap_back.txt");
+}
+
+TEST_CASE( "parallel file encryption", "[Hill]" )
+{
+  INFO("Hint: encryptFileParallel must be byte-identical to encryptFile");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+
+  std::string P;
+  for (unsigned int i = 0; i < (9 << 20) + 1; ++i)
+    P += "PARALLEL CHUNKS?."[i % 17];
+  {
+    std::ofstream f("hill_par_plain.txt", std::ios::binary);
+    f << P;
+  }
+
+  double rate = -1;
+  REQUIRE(H.encryptFileParallel("hill_par_plain.txt", "hill_par_cipher.txt", 4, &rate));
+  REQUIRE(rate >= 0);
+  std::ifstream c("hill_par_cipher.txt", std::ios::binary);
+  std::string C((std::istreambuf_iterator<char>(c)), std::istreambuf_iterator<char>());
+  REQUIRE(C == H.encrypt(P));
+
+  std::remove("hill_par_plain.txt");
+  std::remove("hill_par_cipher.txt");
+}
+
+TEST_CASE( "pipe pipeline", "[Hill]" )
+{
+  INFO("Hint: encryptPipe must write exactly encrypt(everything read)");
+  Hill H;
+  std::string P;
+  for (unsigned int i = 0; i < 300001; ++i)
+    P += "PIPELINED?. "[i % 12];
+
+  int in[2], out[2];
+  REQUIRE(pipe(in) == 0);
+  REQUIRE(pipe(out) == 0);
+
+  std::thread feed([&]() {
+    for (size_t off = 0; off < P.length(); off += 1000)
+      if (write(in[1], P.data() + off, std::min<size_t>(1000, P.length() - off)) <= 0)
+        break;
+    close(in[1]);
+  });
+  std::string C;
+  std::thread drain([&]() {
+    char buf[4096];
+    ssize_t got;
+    while ((got = read(out[0], buf, sizeof(buf))) > 0)
+      C.append(buf, got);
+  });
+
+  REQUIRE(H.encryptPipe(in[0], out[1], 4096, 3));
+  close(out[1]);
+  feed.join();
+  drain.join();
+  close(in[0]);
+  close(out[0]);
+  REQUIRE(C == H.encrypt(P));
+}
+
+TEST_CASE( "random-access decryption", "[Hill]" )
+{
+  INFO("Hint: decryptRange(C, offset, length) must equal decrypt(C).substr(offset, length)");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+  REQUIRE(H.setD(H.inv_mod(E)));
+
+  std::string P;
+  for (unsigned int i = 0; i < 1000; ++i)
+    P += "RANDOM ACCESS?."[i % 15];
+  std::string C = H.encrypt(P);
+  std::string D = H.decrypt(C);
+
+  for (size_t offset = 0; offset < C.length() + 3; offset += 7)
+    for (size_t length = 0; length < 11; ++length)
+      REQUIRE(H.decryptRange(C, offset, length) == D.substr(std::min(offset, D.length()), length));
+
+  // a ciphertext whose length is not a whole number of blocks is padded like decrypt
+  std::string odd = C.substr(0, 101);
+  REQUIRE(H.decryptRange(odd, 95, 100) == H.decrypt(odd).substr(95));
+}
+
+TEST_CASE( "incremental re-encryption", "[Hill]" )
+{
+  INFO("Hint: reencrypt must leave C equal to encrypt(new plaintext)");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+
+  std::string P(500, 'A');
+  for (size_t i = 0; i < P.length(); ++i)
+    P[i] = "RECORDS AND FIELDS."[i % 19];
+  std::string C = H.encrypt(P);
+
+  // overwrite a few records
+  P.replace(10, 4, "EDIT");
+  P.replace(301, 2, "??");
+  REQUIRE(H.reencrypt(C, P, {{10, 4}, {301, 2}}));
+  REQUIRE(C == H.encrypt(P));
+
+  // grow by appending, then shrink into the middle of a block
+  P += "MORE";
+  REQUIRE(H.reencrypt(C, P, {{P.length() - 4, 4}}));
+  REQUIRE(C == H.encrypt(P));
+  P.resize(250);
+  REQUIRE(H.reencrypt(C, P, {}));
+  REQUIRE(C == H.encrypt(P));
+}
+
+TEST_CASE( "record mode", "[Hill]" )
+{
+  INFO("Hint: encryptRecords must keep delimiters and encrypt every record like its own encrypt call");
+  Hill H;
+  std::string P, expect, back;
+  for (unsigned int i = 0; i < 50000; ++i)
+  {
+    std::string record(i % 23, "LOG LINE?."[i % 10]);
+    P += record + "\n";
+    expect += H.encrypt(record) + "\n";
+    back += H.decrypt(H.encrypt(record)) + "\n";
+  }
+  P += "NO NEWLINE";
+  expect += H.encrypt("NO NEWLINE");
+  back += H.decrypt(H.encrypt("NO NEWLINE"));
+
+  REQUIRE(H.encryptRecords(P, '\n', 3) == expect);
+  REQUIRE(H.decryptRecords(expect) == back);
+  REQUIRE(H.encryptRecords("\n\n") == "\n\n");
+  REQUIRE(H.encryptRecords(std::string("AB CD"), ' ') == "");
+  REQUIRE(H.decryptRecords(H.encrypt("AB") + "." + H.encrypt("CD"), '.') == "");
+  REQUIRE(H.encryptRecords(std::string("AB;CD"), ';') == H.encrypt("AB") + ";" + H.encrypt("CD"));
+}
+
+TEST_CASE( "vectorized ingest and egress", "[Hill]" )
+{
+  INFO("Hint: ingest folds case, maps to 0-28 and applies the out-of-alphabet policy; egress reverses it");
+  std::string text;
+  for (unsigned int c = 0; c < 256; ++c)
+    text += static_cast<char>(c);
+  text += text + text;
+
+  std::vector<uint8_t> sym(text.length());
+  REQUIRE(Alphabet::ingest(text.data(), text.length(), &sym[0]) == text.length());
+  for (size_t i = 0; i < text.length(); ++i)
+    REQUIRE(sym[i] == Alphabet::symbol(text[i]));
+  REQUIRE(Alphabet::symbol('q') == Alphabet::symbol('Q'));
+  REQUIRE(Alphabet::symbol('\n') == 0);
+
+  std::string clean(200, ' ');
+  for (size_t i = 0; i < clean.length(); ++i)
+    clean[i] = "Hello World?."[i % 13];
+  REQUIRE(Alphabet::ingest(clean.data(), clean.length(), &sym[0], Alphabet::REJECT) == clean.length());
+  std::string back(clean.length(), ' ');
+  Alphabet::egress(&sym[0], clean.length(), &back[0]);
+  for (size_t i = 0; i < clean.length(); ++i)
+    REQUIRE(back[i] == toupper(clean[i]));
+
+  clean[137] = '#';
+  std::fill(sym.begin(), sym.end(), 99);
+  REQUIRE(Alphabet::ingest(clean.data(), clean.length(), &sym[0], Alphabet::REJECT) == 137);
+  for (size_t i = 0; i < 137; ++i)
+    REQUIRE(sym[i] == Alphabet::symbol(clean[i]));
+
+  //the policy reaches the cipher: REJECT refuses the text and names the offending character
+  Hill H;
+  size_t rejected = 0;
+  REQUIRE(H.encrypt(clean, Alphabet::REJECT, &rejected) == "");
+  REQUIRE(rejected == 137);
+  REQUIRE(H.encrypt(clean, Alphabet::ZERO, &rejected) == H.encrypt(clean));
+  REQUIRE(rejected == clean.length());
+  clean[137] = 'a';
+  REQUIRE(H.encrypt(clean, Alphabet::REJECT, &rejected) == H.encrypt(clean));
+  REQUIRE(rejected == clean.length());
+  std::string C = H.encrypt(clean);
+  C[3] = '\n';
+  REQUIRE(H.decrypt(C, Alphabet::REJECT, &rejected) == "");
+  REQUIRE(rejected == 3);
+}
+
+TEST_CASE( "packed binary ciphertext", "[Hill]" )
+{
+  INFO("Hint: 13 symbols per 64-bit word, and decryptPacked must undo encryptPacked");
+  std::vector<uint8_t> sym(1000), back(1000);
+  for (size_t i = 0; i < sym.size(); ++i)
+    sym[i] = (i * 17 + 5) % 29;
+  sym[0] = sym[1] = 28;
+  std::vector<uint64_t> words(PackedFormat::words(sym.size()));
+  PackedFormat::pack(&sym[0], sym.size(), &words[0]);
+  PackedFormat::unpack(&words[0], sym.size(), &back[0]);
+  REQUIRE(back == sym);
+
+  Hill H;
+  std::string P;
+  for (unsigned int i = 0; i < 9999; ++i)
+    P += "PACKED CIPHERTEXT?."[i % 19];
+  std::string C = H.encryptPacked(P);
+  REQUIRE(C.length() == PackedFormat::HEADER + 8 * PackedFormat::words(10000));
+  REQUIRE(C.length() * 100 < H.encrypt(P).length() * 65);
+  REQUIRE(H.decryptPacked(C) == P);
+  REQUIRE(H.decryptPacked(C.substr(0, C.length() - 1)) == "");
+
+  //crafted input: a word past 29^13 and a length that would wrap when rounded up to whole blocks
+  std::string wide = C;
+  for (int i = 0; i < 8; ++i)
+    wide[PackedFormat::HEADER + i] = '\xff';
+  REQUIRE(H.decryptPacked(wide) == "");
+  std::string huge = C;
+  for (int i = 8; i < 16; ++i)
+    huge[i] = '\xff';
+  REQUIRE(H.decryptPacked(huge) == "");
+  huge[8] = '\xfe';
+  REQUIRE(H.decryptPacked(huge) == "");
+
+  //the header has one byte for the block size, so a 256x256 key cannot be recorded
+  std::vector<int> identity(256 * 256, 0);
+  for (unsigned int i = 0; i < 256; ++i)
+    identity[i * 257] = 1;
+  Hill big;
+  REQUIRE(big.setE(Matrix(identity, 256, 256)));
+  REQUIRE(big.encryptPacked("TOO WIDE") == "");
+  REQUIRE(PackedFormat::encode(&sym[0], 256, 256, 256) == "");
+}
+
+TEST_CASE( "indexed container", "[Hill]" )
+{
+  INFO("Hint: segments decode independently, in parallel or by random access");
+  Hill H;
+
+  std::string P;
+  for (unsigned int i = 0; i < 100000; ++i)
+    P += "SEGMENTED CONTAINER?. "[i % 22];
+  P += "TAIL";
+  {
+    std::ofstream f("hill_box_plain.txt", std::ios::binary);
+    f << P;
+  }
+  REQUIRE(H.encryptContainer("hill_box_plain.txt", "hill_box.h29", 1000, 3));
+
+  Container box;
+  REQUIRE(box.open("hill_box.h29"));
+  REQUIRE(box.length() == P.length());
+  REQUIRE(box.index().size() == (P.length() + 999) / 1000);
+
+  BlockKernel D(H.getD());
+  std::string all;
+  REQUIRE(box.decrypt(D, all, 4));
+  REQUIRE(all == P);
+  REQUIRE(box.range(D, 999, 10) == P.substr(999, 10));
+  REQUIRE(box.range(D, P.length() - 5, 100) == P.substr(P.length() - 5));
+
+  std::string seg;
+  REQUIRE(box.segment(1, D, seg));
+  REQUIRE(seg == P.substr(1000, 1000));
+
+  REQUIRE(H.decryptContainer("hill_box.h29", "hill_box_back.txt"));
+  std::ifstream b("hill_box_back.txt", std::ios::binary);
+  std::string B((std::istreambuf_iterator<char>(b)), std::istreambuf_iterator<char>());
+  REQUIRE(B == P);
+  REQUIRE(!H.decryptContainer("hill_box.h29", "hill_box.h29"));
+  REQUIRE(!H.encryptContainer("hill_box_plain.txt", "hill_box_plain.txt"));
+
+  //index entries that disagree with the layout write() produces are refused at open
+  std::ifstream raw("hill_box.h29", std::ios::binary);
+  std::string file((std::istreambuf_iterator<char>(raw)), std::istreambuf_iterator<char>());
+  size_t index = 0;
+  for (int i = 7; i >= 0; --i)
+    index = (index << 8) | static_cast<unsigned char>(file[file.size() - Container::TRAILER + 8 + i]);
+  const size_t fields[] = { 0, 8, 16 }; //offset, ciphertext length, plaintext length of the first entry
+  for (unsigned int f = 0; f < 3; ++f)
+  {
+    std::string bad = file;
+    bad[index + fields[f]] ^= 2;
+    {
+      std::ofstream o("hill_box_bad.h29", std::ios::binary);
+      o << bad;
+    }
+    Container broken;
+    REQUIRE(!broken.open("hill_box_bad.h29"));
+  }
+
+  //the header has one byte for the block size, so a 256x256 key cannot be recorded
+  std::vector<int> identity(256 * 256, 0);
+  for (unsigned int i = 0; i < 256; ++i)
+    identity[i * 257] = 1;
+  BlockKernel wide(Matrix(identity, 256, 256));
+  REQUIRE(!Container::write("hill_box_bad.h29", P.data(), P.length(), wide, 1000, 1));
+
+  std::remove("hill_box_plain.txt");
+  std::remove("hill_box.h29");
+  std::remove("hill_box_back.txt");
+  std::remove("hill_box_bad.h29");
+}
+
+TEST_CASE( "modular inverse for larger keys", "[Hill]" )
+{
+  INFO("Hint: the inverse is taken over Z_29, not over the rationals");
+  Hill H2;
+  std::vector<int> d2 = {12,2,16,28};
+  REQUIRE(H2.getD().equal(Matrix(d2, 2, 2)));
+
+  //the 3x3 key has a zero leading entry, so the elimination must swap rows
+  std::vector<int> e3 = {0,1,4, 1,0,5, 2,3,0};
+  std::vector<int> e5(25, 1);
+  for (unsigned int i = 0; i < 5; ++i)
+    e5[i * 6] = 10;
+  std::vector<Matrix> keys = {Matrix(e3, 3, 3), Matrix(e5, 5, 5)};
+  for (size_t k = 0; k < keys.size(); ++k)
+  {
+    Hill H(keys[k], true);
+    unsigned int n = keys[k].size(1);
+    REQUIRE(H.getD().size(1) == n);
+    for (unsigned int i = 0; i < n; ++i)
+      for (unsigned int j = 0; j < n; ++j)
+      {
+        int sum = 0;
+        for (unsigned int a = 0; a < n; ++a)
+          sum += H.getE().get(i, a) * H.getD().get(a, j);
+        REQUIRE(sum % 29 == (i == j ? 1 : 0));
+      }
+    std::string P = "INVERTIBLE MOD TWENTY NINE?";
+    REQUIRE(H.decrypt(H.encrypt(P)).substr(0, P.length()) == P);
+  }
+}
+
+TEST_CASE( "modular inverse edge cases", "[Hill]" )
+{
+  INFO("Hint: entries are reduced into [0,29) first, negative multiples of 29 included, then pivots may need row swaps");
+  Hill H;
+  //negative multiples of 29 reduce to 0, so this is the swap matrix [[0,1],[1,0]], its own inverse
+  std::vector<int> swap = {-29, 1, 1, -58};
+  std::vector<int> identitySwap = {0, 1, 1, 0};
+  REQUIRE(H.inv_mod(Matrix(swap, 2, 2)).equal(Matrix(identitySwap, 2, 2)));
+
+  //-1 is 28 mod 29, and 28 * 28 = 784 = 27 * 29 + 1
+  std::vector<int> minus = {-1, 0, 0, -1};
+  std::vector<int> minusInverse = {28, 0, 0, 28};
+  REQUIRE(H.inv_mod(Matrix(minus, 2, 2)).equal(Matrix(minusInverse, 2, 2)));
+
+  //determinant 29: invertible over the rationals but not mod 29
+  std::vector<int> singular = {1, 2, 3, 35};
+  REQUIRE(H.inv_mod(Matrix(singular, 2, 2)).size(1) == 0);
+  REQUIRE(!H.setE(Matrix(singular, 2, 2)));
+  std::vector<int> wide = {1, 0, 0, 0, 1, 0};
+  REQUIRE(H.inv_mod(Matrix(wide, 2, 3)).size(1) == 0);
+
+  //zeros on the whole leading diagonal and negative entries: every column needs a swap
+  std::vector<int> e4 = {0, -3, 1, 0,  2, 0, 0, 1,  -1, 0, 0, 4,  0, 5, -30, 0};
+  Matrix A(e4, 4, 4);
+  Matrix inverse = H.inv_mod(A);
+  REQUIRE(inverse.size(1) == 4);
+  for (unsigned int i = 0; i < 4; ++i)
+    for (unsigned int j = 0; j < 4; ++j)
+    {
+      int sum = 0;
+      for (unsigned int a = 0; a < 4; ++a)
+      {
+        REQUIRE(inverse.get(a, j) >= 0);
+        REQUIRE(inverse.get(a, j) < 29);
+        sum += A.get(i, a) * inverse.get(a, j);
+      }
+      REQUIRE(((sum % 29) + 29) % 29 == (i == j ? 1 : 0));
+    }
+}
+
+TEST_CASE( "encryption daemon", "[Hill]" )
+{
+  INFO("Hint: pipelined requests are batched and answered by id");
+  Hill H;
+  Daemon d(H);
+  REQUIRE(d.listen("hill_test.sock"));
+  std::thread server([&d]() { d.run(); });
+
+  DaemonClient a;
+  DaemonClient b;
+  REQUIRE(a.connect("hill_test.sock"));
+  REQUIRE(b.connect("hill_test.sock"));
+
+  std::vector<std::string> texts;
+  for (unsigned int i = 0; i < 50; ++i)
+    texts.push_back(std::string(i % 7 + 1, "DAEMON? ."[i % 9]) + "FIELD");
+  for (unsigned int i = 0; i < texts.size(); ++i)
+  {
+    REQUIRE(a.send(i, Frame::ENCRYPT, texts[i]));
+    REQUIRE(b.send(1000 + i, Frame::DECRYPT, H.encrypt(texts[i])));
+  }
+  std::vector<std::string> got(texts.size());
+  for (unsigned int i = 0; i < texts.size(); ++i)
+  {
+    uint32_t id;
+    uint8_t status;
+    std::string text;
+    REQUIRE(a.receive(id, status, text));
+    REQUIRE(status == Frame::OK);
+    REQUIRE(id < texts.size());
+    REQUIRE(text == H.encrypt(texts[id]));
+    REQUIRE(b.receive(id, status, text));
+    REQUIRE(status == Frame::OK);
+    REQUIRE(text == H.decrypt(H.encrypt(texts[id - 1000])));
+  }
+
+  std::string result;
+  REQUIRE(a.call(Frame::ENCRYPT, "", result));
+  REQUIRE(result.empty());
+  REQUIRE(!a.call(7, "UNKNOWN OP", result));
+
+  //a client that half-closes right after pipelining still gets every reply, then the server closes
+  DaemonClient c;
+  REQUIRE(c.connect("hill_test.sock"));
+  for (unsigned int i = 0; i < texts.size(); ++i)
+    REQUIRE(c.send(i, Frame::ENCRYPT, texts[i]));
+  REQUIRE(::shutdown(c.fd(), SHUT_WR) == 0);
+  for (unsigned int i = 0; i < texts.size(); ++i)
+  {
+    uint32_t id;
+    uint8_t status;
+    std::string text;
+    REQUIRE(c.receive(id, status, text));
+    REQUIRE(status == Frame::OK);
+    REQUIRE(text == H.encrypt(texts[id]));
+  }
+  uint32_t id;
+  uint8_t status;
+  REQUIRE(!c.receive(id, status, result));
+
+  //a client that only sends is no longer read once enough replies wait for it, so its socket fills up
+  DaemonClient flood;
+  REQUIRE(flood.connect("hill_test.sock"));
+  Frame f;
+  f.length = 64 << 10;
+  f.op = Frame::ENCRYPT;
+  f.status = 0;
+  std::string frames;
+  for (uint32_t i = 0; i < 16; ++i)
+  {
+    char header[Frame::HEADER];
+    f.id = i;
+    f.encode(header);
+    frames += std::string(header, Frame::HEADER) + std::string(f.length, 'F');
+  }
+  int flags = ::fcntl(flood.fd(), F_GETFL);
+  REQUIRE(::fcntl(flood.fd(), F_SETFL, flags | O_NONBLOCK) == 0);
+  size_t sent = 0;
+  for (unsigned int stalls = 0; stalls < 10 && sent < (size_t(256) << 20); )
+  {
+    ssize_t put = ::write(flood.fd(), frames.data() + sent % frames.size(), frames.size() - sent % frames.size());
+    if (put > 0)
+    {
+      sent += static_cast<size_t>(put);
+      stalls = 0;
+    }
+    else
+    {
+      ++stalls;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+  }
+  REQUIRE(sent < (size_t(64) << 20));
+  //reading the replies lets it in again, and every complete request is answered
+  REQUIRE(::fcntl(flood.fd(), F_SETFL, flags) == 0);
+  REQUIRE(::shutdown(flood.fd(), SHUT_WR) == 0);
+  size_t complete = sent / (Frame::HEADER + f.length);
+  std::string reply;
+  for (size_t i = 0; i < complete; ++i)
+  {
+    REQUIRE(flood.receive(id, status, reply));
+    REQUIRE(reply == H.encrypt(std::string(f.length, 'F')));
+  }
+  REQUIRE(!flood.receive(id, status, reply));
+
+  d.stop();
+  server.join();
+}
+
+TEST_CASE( "shared-memory transport", "[Hill]" )
+{
+  INFO("Hint: requests are transformed in place in the client's shared slots");
+  Hill H;
+  ShmServer server(H);
+  REQUIRE(server.start("/hill_test_shm", 2));
+
+  ShmClient a;
+  REQUIRE(a.attach("/hill_test_shm"));
+  REQUIRE(a.blockSize() == 2);
+
+  std::string result;
+  REQUIRE(a.call(ShmSegment::ENCRYPT, "SHARED MEMORY", result));
+  REQUIRE(result == H.encrypt("SHARED MEMORY"));
+  REQUIRE(a.call(ShmSegment::DECRYPT, result, result));
+  REQUIRE(result == "SHARED MEMORY.");
+  REQUIRE(!a.call(ShmSegment::ENCRYPT, std::string(ShmSegment::SLOT_BYTES + 1, 'A'), result));
+
+  //every slot in flight at once, from two clients
+  ShmClient b;
+  REQUIRE(b.attach("/hill_test_shm"));
+  std::vector<std::string> texts(ShmSegment::SLOTS);
+  for (unsigned int i = 0; i < texts.size(); ++i)
+  {
+    texts[i] = std::string(i + 1, "RING? ."[i % 6]);
+    int slot = b.acquire();
+    REQUIRE(slot >= 0);
+    std::copy(texts[i].begin(), texts[i].end(), b.buffer(slot));
+    REQUIRE(b.submit(slot, ShmSegment::ENCRYPT, texts[i].size()));
+    REQUIRE(a.call(ShmSegment::ENCRYPT, texts[i], result));
+    REQUIRE(result == H.encrypt(texts[i]));
+  }
+  REQUIRE(b.acquire() == -1);
+  for (unsigned int i = 0; i < texts.size(); ++i)
+  {
+    int slot;
+    size_t length;
+    REQUIRE(b.complete(slot, length));
+    REQUIRE(std::string(b.buffer(slot), length) == H.encrypt(texts[slot])); //acquire hands out slots from 0 up
+    b.release(slot);
+  }
+
+  //a client that leaves with requests in flight waits for them, so the next owner of its entry gets no stale replies
+  std::string big(ShmSegment::SLOT_BYTES - 2, 'Q');
+  for (unsigned int round = 0; round < 20; ++round)
+  {
+    {
+      ShmClient c;
+      REQUIRE(c.attach("/hill_test_shm"));
+      for (unsigned int i = 0; i < ShmSegment::SLOTS; ++i)
+      {
+        int slot = c.acquire();
+        std::copy(big.begin(), big.end(), c.buffer(slot));
+        REQUIRE(c.submit(slot, ShmSegment::ENCRYPT, big.size()));
+      }
+    }
+    ShmClient d;
+    REQUIRE(d.attach("/hill_test_shm"));
+    REQUIRE(d.call(ShmSegment::ENCRYPT, texts[round], result));
+    REQUIRE(result == H.encrypt(texts[round]));
+  }
+  server.stop();
+}
+
+TEST_CASE( "latency histogram", "[Hill]" )
+{
+  INFO("Hint: buckets are exact below 128 ns and within 1.6% above");
+  LatencyHistogram h;
+  REQUIRE(h.count() == 0);
+  REQUIRE(h.percentile(99) == 0);
+  for (uint64_t v = 1; v <= 100; ++v)
+    h.record(v);
+  REQUIRE(h.count() == 100);
+  REQUIRE(h.min() == 1);
+  REQUIRE(h.max() == 100);
+  REQUIRE(h.percentile(50) == 50);
+  REQUIRE(h.percentile(99) == 99);
+  REQUIRE(h.mean() == Approx(50.5));
+
+  LatencyHistogram slow;
+  for (unsigned int i = 0; i < 100; ++i)
+    slow.record(1000000 + i * 10000);
+  h.merge(slow);
+  REQUIRE(h.count() == 200);
+  REQUIRE(h.max() == 1990000);
+  uint64_t p75 = h.percentile(75);
+  REQUIRE(p75 >= 1490000 * 0.984);
+  REQUIRE(p75 <= 1490000 * 1.016);
+  REQUIRE(h.percentile(100) == 1990000);
+}
+
+TEST_CASE( "key rotation under load", "[Hill]" )
+{
+  INFO("Hint: readers must always see a whole key pair, never half of one");
+  std::vector<Matrix> keys;
+  for (unsigned int i = 0; i < 4; ++i)
+    keys.push_back(KeyFile::random(2 + i, i));
+  SharedKey key(keys[0]);
+  REQUIRE(key.size() == 2);
+  std::vector<int> singular = {1,2,2,4};
+  REQUIRE(!key.rotate(Matrix(singular, 2, 2)));
+
+  //32 encrypting threads while the key changes every 100 microseconds (10k rotations per second)
+  std::atomic<bool> running(true);
+  std::atomic<unsigned int> failures(0);
+  std::atomic<unsigned long> reads(0);
+  std::vector<std::thread> readers;
+  for (unsigned int t = 0; t < 32; ++t)
+    readers.push_back(std::thread([&]() {
+      SharedKey::Reader r(key);
+      std::string P = "ROTATE WHILE READING?";
+      while (running.load())
+      {
+        const SharedKey::Snapshot& s = r.lock();
+        std::string C(s.EK.padded(P.length()), ' ');
+        s.EK.text(P.data(), P.length(), &C[0]);
+        std::string B(C.length(), ' ');
+        s.DK.text(C.data(), C.length(), &B[0]);
+        r.unlock();
+        if (B.compare(0, P.length(), P) != 0)
+          ++failures;
+        ++reads;
+      }
+    }));
+
+  unsigned int rotations = 0;
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+  while (std::chrono::steady_clock::now() < stop || rotations < 100)
+  {
+    REQUIRE(key.rotate(keys[++rotations % keys.size()]));
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  running = false;
+  for (size_t t = 0; t < readers.size(); ++t)
+    readers[t].join();
+
+  REQUIRE(failures.load() == 0);
+  REQUIRE(reads.load() > 0);
+
+  //with every reader gone the next rotation frees all replaced snapshots
+  REQUIRE(key.rotate(keys[0]));
+  REQUIRE(key.retired() == 0);
+  SharedKey::Reader r(key);
+  REQUIRE(r.lock().version == rotations + 2);
+  r.unlock();
+  REQUIRE(r.decrypt(r.encrypt("SNAPSHOT")) == "SNAPSHOT");
+}
+
+TEST_CASE( "multi-tenant key registry", "[Hill]" )
+{
+  INFO("Hint: lookups are lock-free and returned keys never move");
+  std::vector<Matrix> keys;
+  for (unsigned int i = 0; i < 6; ++i)
+    keys.push_back(KeyFile::random(2 + i % 5, 100 + i));
+
+  KeyRegistry registry(8);
+  std::vector<int> singular = {1,2,2,4};
+  REQUIRE(!registry.set(1, Matrix(singular, 2, 2)));
+  REQUIRE(!registry.set(KeyRegistry::NO_TENANT, keys[0]));
+  REQUIRE(registry.find(1) == nullptr);
+
+  REQUIRE(registry.set(7, keys[1]));
+  const KeyRegistry::Key* first = registry.find(7);
+  REQUIRE(first != nullptr);
+  REQUIRE(first->encryption().equal(keys[1]));
+  Hill H(keys[1], true);
+  REQUIRE(first->encrypt("TENANT SEVEN?") == H.encrypt("TENANT SEVEN?"));
+  REQUIRE(first->decrypt(H.encrypt("TENANT SEVEN?")) == H.decrypt(H.encrypt("TENANT SEVEN?")));
+
+  //readers look tenants up while the shards grow underneath them
+  const uint64_t TENANTS = 50000;
+  std::atomic<bool> filling(true);
+  std::atomic<unsigned int> wrong(0);
+  std::thread reader([&]() {
+    while (filling.load())
+      for (uint64_t t = 1000; t < 1000 + TENANTS; t += 97)
+      {
+        const KeyRegistry::Key* k = registry.find(t);
+        if (k && k->n != 2 + (t % 6) % 5)
+          ++wrong;
+      }
+  });
+  for (uint64_t t = 1000; t < 1000 + TENANTS; ++t)
+    REQUIRE(registry.set(t, keys[t % 6]));
+  filling = false;
+  reader.join();
+  REQUIRE(wrong.load() == 0);
+  REQUIRE(registry.size() == TENANTS + 1);
+  REQUIRE(registry.find(7) == first);
+  for (uint64_t t = 1000; t < 1000 + TENANTS; t += 1013)
+    REQUIRE(registry.find(t)->encryption().equal(keys[t % 6]));
+
+  //replacing and removing leave earlier pointers usable
+  REQUIRE(registry.set(7, keys[2]));
+  REQUIRE(registry.find(7)->encryption().equal(keys[2]));
+  REQUIRE(first->encryption().equal(keys[1]));
+  REQUIRE(registry.remove(7));
+  REQUIRE(!registry.remove(7));
+  REQUIRE(registry.find(7) == nullptr);
+  REQUIRE(registry.size() == TENANTS);
+  //16-byte entries in tables under 3/4 full (plus the outgrown halves) and 4 + 2n^2 bytes per key, n <= 6
+  REQUIRE(registry.memory() < TENANTS * 160);
+
+  //rotating keys takes new arena space until reclaim() hands the replaced keys back
+  size_t before = registry.memory();
+  for (unsigned int round = 0; round < 20; ++round)
+  {
+    for (uint64_t t = 1000; t < 1000 + TENANTS; t += 7)
+      REQUIRE(registry.set(t, keys[(t + round) % 6]));
+    registry.reclaim();
+  }
+  REQUIRE(registry.memory() < before + TENANTS * 20);
+  for (uint64_t t = 1000; t < 1000 + TENANTS; t += 7 * 145)
+    REQUIRE(registry.find(t)->encryption().equal(keys[(t + 19) % 6]));
+
+  //tenants that come and go leave removed entries behind; rehashing drops them instead of doubling the table
+  KeyRegistry churn(1);
+  size_t settled = 0;
+  for (uint64_t round = 0; round < 40; ++round)
+  {
+    for (uint64_t t = 0; t < 1000; ++t)
+      REQUIRE(churn.set(round * 1000 + t, keys[t % 6]));
+    for (uint64_t t = 0; t < 1000; ++t)
+      REQUIRE(churn.remove(round * 1000 + t));
+    churn.reclaim();
+    if (round == 9)
+      settled = churn.memory();
+  }
+  REQUIRE(churn.size() == 0);
+  REQUIRE(churn.memory() <= settled);
+}
+
+TEST_CASE( "key-version framed ciphertext", "[Hill]" )
+{
+  INFO("Hint: the frame names its key version, so old and new keys decrypt side by side");
+  std::vector<Matrix> keys;
+  for (unsigned int i = 0; i < 3; ++i)
+    keys.push_back(KeyFile::random(2 + i, 200 + i));
+  SharedKey key(keys[0]);
+  SharedKey::Reader r(key);
+
+  std::string P = "ROLLOVER WITHOUT DOWNTIME";
+  std::string v1 = r.encryptFramed(P);
+  uint64_t version;
+  size_t header;
+  REQUIRE(SharedKey::frameVersion(v1, version, header));
+  REQUIRE(version == 1);
+  REQUIRE(header == 2);
+  REQUIRE(static_cast<unsigned char>(v1[0]) == SharedKey::MAGIC);
+  REQUIRE(v1.substr(header) == Hill(keys[0], true).encrypt(P));
+
+  REQUIRE(key.rotate(keys[1], 300));
+  REQUIRE(!key.rotate(keys[2], 300));
+  REQUIRE(!key.rotate(keys[2], 299));
+  std::string v300 = r.encryptFramed(P);
+  REQUIRE(SharedKey::frameVersion(v300, version, header));
+  REQUIRE(version == 300);
+  REQUIRE(header == 3);
+
+  //both versions decrypt while cached, without trying keys
+  std::string B;
+  REQUIRE(r.decryptFramed(v1, B));
+  REQUIRE(B.compare(0, P.length(), P) == 0);
+  REQUIRE(r.decryptFramed(v300, B));
+  REQUIRE(B.compare(0, P.length(), P) == 0);
+  REQUIRE(!r.decryptFramed("\xff", B));
+  REQUIRE(!r.decryptFramed("HV\x01" "ABCD", B));
+  //plain ciphertext that happens to start with the old "HV" magic is not mistaken for a frame
+  REQUIRE(!SharedKey::frameVersion("HV\x01" "ABCD", version, header));
+
+  //varints must be minimal and fit 64 bits
+  REQUIRE(SharedKey::frameVersion(std::string("\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01"), version, header));
+  REQUIRE(version == ~0ULL);
+  REQUIRE(header == 11);
+  REQUIRE(!SharedKey::frameVersion(std::string("\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02"), version, header));
+  REQUIRE(!SharedKey::frameVersion(std::string("\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01"), version, header));
+  REQUIRE(!SharedKey::frameVersion(std::string("\xff\x81\x00", 3), version, header));
+
+  //once a version falls out of the cache its frames are refused rather than decrypted with the wrong key
+  for (unsigned int i = 0; i < SharedKey::VERSIONS; ++i)
+    REQUIRE(key.rotate(keys[2]));
+  REQUIRE(r.lock().version == 300 + SharedKey::VERSIONS);
+  r.unlock();
+  REQUIRE(!r.decryptFramed(v1, B));
+  REQUIRE(!r.decryptFramed(v300, B));
+
+  //an evicted version is never handed out again, so its old frames cannot meet a different key
+  REQUIRE(!key.rotate(keys[0], 1));
+  REQUIRE(!key.rotate(keys[0], 300));
+  REQUIRE(key.rotate(keys[0], 1000));
+  REQUIRE(!r.decryptFramed(v1, B));
+}
+
+TEST_CASE( "encrypted append-only log", "[Hill]" )
+{
+  INFO("Hint: records from all producers are grouped into few writes and decrypt line by line");
+  Hill H;
+  BlockKernel E(H.getE());
+  std::remove("hill_audit.log");
+  unsigned int races = 0;
+  {
+    EncryptedLog log(E, 4096, 2000);
+    REQUIRE(!log.append("NOT OPEN"));
+    REQUIRE(log.open("hill_audit.log"));
+    std::vector<std::thread> producers;
+    for (unsigned int t = 0; t < 4; ++t)
+      producers.push_back(std::thread([&log, t]() {
+        for (unsigned int i = 0; i < 2000; ++i)
+          log.append("PRODUCER " + std::string(1, 'A' + t) + " EVENT " + std::string(i % 13, '?'));
+      }));
+    for (size_t t = 0; t < producers.size(); ++t)
+      producers[t].join();
+    REQUIRE(log.flush());
+    REQUIRE(log.groups() < 8000 / 4);
+    REQUIRE(log.append("LAST"));
+    REQUIRE(log.close());
+    REQUIRE(!log.append("CLOSED"));
+
+    //reopened, the writer must not wait for records it already took before the close
+    REQUIRE(log.open("hill_audit.log"));
+    REQUIRE(log.append("REOPENED"));
+    REQUIRE(log.flush());
+
+    //every append that succeeds while close runs is on disk when close returns
+    std::atomic<unsigned int> accepted(0);
+    std::atomic<bool> started(false);
+    std::vector<std::thread> racers;
+    for (unsigned int t = 0; t < 2; ++t)
+      racers.push_back(std::thread([&log, &accepted, &started]() {
+        while (log.append("RACE"))
+        {
+          ++accepted;
+          started = true;
+        }
+      }));
+    while (!started)
+      std::this_thread::yield();
+    REQUIRE(log.close());
+    for (size_t t = 0; t < racers.size(); ++t)
+      racers[t].join();
+    races = accepted;
+  }
+
+  std::ifstream f("hill_audit.log", std::ios::binary);
+  std::string C((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  std::stringstream lines(H.decryptRecords(C));
+  std::vector<unsigned int> next(4, 0); //records of one producer stay in order
+  std::string line;
+  unsigned int count = 0;
+  unsigned int raced = 0;
+  while (std::getline(lines, line))
+  {
+    ++count;
+    if (line.compare(0, 4, "RACE") == 0)
+      ++raced;
+    if (line.compare(0, 4, "LAST") == 0 || line.compare(0, 8, "REOPENED") == 0 || line.compare(0, 4, "RACE") == 0)
+      continue;
+    unsigned int t = line[9] - 'A';
+    REQUIRE(t < 4);
+    unsigned int i = next[t]++;
+    std::string expected = "PRODUCER " + std::string(1, 'A' + t) + " EVENT " + std::string(i % 13, '?');
+    REQUIRE(line.compare(0, expected.length(), expected) == 0);
+  }
+  REQUIRE(raced == races);
+  REQUIRE(count == 8002 + races);
+  std::remove("hill_audit.log");
+}
+
+TEST_CASE( "work-stealing thread pool", "[Hill]" )
+{
+  INFO("Hint: nested tasks stay on the submitting worker's deque, idle workers steal the oldest ones");
+  ThreadPool pool(2);
+  const int CHILDREN = 100;
+  std::thread::id parent;
+  std::vector<std::thread::id> ran(CHILDREN);
+  std::vector<int> order(CHILDREN);
+  std::atomic<int> started(0);
+  pool.submit([&]() {
+    parent = std::this_thread::get_id();
+    for (int i = 0; i < CHILDREN; ++i)
+      pool.submit([&, i]() {
+        ran[i] = std::this_thread::get_id();
+        order[i] = started++;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      });
+  });
+  pool.wait();
+
+  //the splitting worker runs its own pieces newest first; the other worker steals them oldest first, so every piece
+  //went to the splitting worker's deque
+  int local = -1, stolen = -1, thefts = 0;
+  for (int i = CHILDREN - 1; i >= 0; --i)
+    if (ran[i] == parent)
+    {
+      REQUIRE(order[i] > local);
+      local = order[i];
+    }
+  for (int i = 0; i < CHILDREN; ++i)
+    if (ran[i] != parent)
+    {
+      REQUIRE(order[i] > stolen);
+      stolen = order[i];
+      ++thefts;
+    }
+  REQUIRE(thefts > 0);
+  REQUIRE(thefts < CHILDREN);
+  REQUIRE(pool.steals() >= static_cast<size_t>(thefts));
+
+  //a timed wait gives up while a task is still running
+  std::atomic<bool> release(false);
+  pool.submit([&release]() {
+    while (!release.load())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  REQUIRE(!pool.wait(20));
+  release = true;
+  REQUIRE(pool.wait(5000));
+}
+
+TEST_CASE( "directory tree encryption", "[Hill]" )
+{
+  INFO("Hint: every output file must equal encrypt() of its input, large files are split into stealable pieces");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+  const char *paths[] = { "a.txt", "empty.txt", "sub/b.txt", "sub/deep/c.txt" };
+  const size_t sizes[] = { 300001, 0, 12345, 7 };
+  ::mkdir("hill_tree", 0777);
+  ::mkdir("hill_tree/sub", 0777);
+  ::mkdir("hill_tree/sub/deep", 0777);
+  std::vector<std::string> P(4);
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    for (size_t j = 0; j < sizes[i]; ++j)
+      P[i] += "TREE OF FILES?."[(i + j) % 15];
+    std::ofstream f(std::string("hill_tree/") + paths[i], std::ios::binary);
+    f << P[i];
+  }
+
+  BlockKernel K(H.getE());
+  TreeEncryptor tree(K, 4, 4096);
+  TreeEncryptor::Progress last = {};
+  unsigned int calls = 0;
+  REQUIRE(tree.run("hill_tree", "hill_tree_out", [&](const TreeEncryptor::Progress &p) { last = p; ++calls; }, 1));
+  REQUIRE(calls >= 1);
+  REQUIRE(last.filesDone == 4);
+  REQUIRE(last.filesTotal == 4);
+  REQUIRE(last.bytesDone == 300001 + 12345 + 7);
+  REQUIRE(last.bytesDone == last.bytesTotal);
+  REQUIRE(tree.files().size() == 4);
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    REQUIRE(tree.files()[i].ok);
+    std::ifstream c(std::string("hill_tree_out/") + paths[i], std::ios::binary);
+    std::string C((std::istreambuf_iterator<char>(c)), std::istreambuf_iterator<char>());
+    REQUIRE(C == H.encrypt(P[i]));
+  }
+
+  BlockKernel empty;
+  TreeEncryptor none(empty);
+  REQUIRE(!none.run("hill_tree", "hill_tree_out"));
+  TreeEncryptor missing(K);
+  REQUIRE(!missing.run("hill_tree_missing", "hill_tree_out"));
+
+  //overlapping trees are refused before anything is written, symlinks are not followed
+  TreeEncryptor overlap(K);
+  REQUIRE(!overlap.run("hill_tree", "hill_tree"));
+  REQUIRE(!overlap.run("hill_tree", "./hill_tree/sub/../enc"));
+  REQUIRE(::access("hill_tree/enc", F_OK) != 0);
+  REQUIRE(::symlink("..", "hill_tree/sub/loop") == 0);
+  REQUIRE(overlap.run("hill_tree", "hill_tree_out"));
+  REQUIRE(overlap.files().size() == 4);
+  REQUIRE(::access("hill_tree_out/sub/loop", F_OK) != 0);
+  std::remove("hill_tree/sub/loop");
+
+  //an output that is a hard link to its input fails that file and leaves the input intact
+  std::remove("hill_tree_out/sub/deep/c.txt");
+  REQUIRE(::link("hill_tree/sub/deep/c.txt", "hill_tree_out/sub/deep/c.txt") == 0);
+  REQUIRE(!overlap.run("hill_tree", "hill_tree_out"));
+  std::ifstream linked("hill_tree/sub/deep/c.txt", std::ios::binary);
+  std::string L((std::istreambuf_iterator<char>(linked)), std::istreambuf_iterator<char>());
+  REQUIRE(L == P[3]);
+
+  for (unsigned int i = 4; i-- > 0; )
+  {
+    std::remove((std::string("hill_tree/") + paths[i]).c_str());
+    std::remove((std::string("hill_tree_out/") + paths[i]).c_str());
+  }
+  const char *dirs[] = { "sub/deep", "sub", "" };
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    std::remove((std::string("hill_tree/") + dirs[i]).c_str());
+    std::remove((std::string("hill_tree_out/") + dirs[i]).c_str());
+  }
+}
+
+TEST_CASE( "selective column encryption", "[Hill]" )
+{
+  INFO("Hint: only the chosen fields become encrypt(unquoted content); every other byte is copied unchanged");
+  Matrix E(std::vector<int>{1, 3, 3, 5, 5, 6, 3, 2, 3}, 3, 3);
+  Hill H;
+  REQUIRE(H.setE(E));
+  BlockKernel K(H.getE());
+  BlockKernel D(H.getD());
+
+  ColumnCipher csv(K, std::vector<unsigned int>{1, 3}, ',', true, 1);
+  REQUIRE(csv.transform("id,name,city,note\n1,JOHN,PARIS,X\n") ==
+          "id," + H.encrypt("name") + ",city," + H.encrypt("note") + "\n1," + H.encrypt("JOHN") + ",PARIS," + H.encrypt("X") + "\n");
+  REQUIRE(csv.transform("2,\"DOE, JANE \"\"JD\"\"\",\"A,B\",\"MULTI\nLINE\"\r\n3,,C") ==
+          "2," + H.encrypt("DOE, JANE \"JD\"") + ",\"A,B\"," + H.encrypt("MULTI\nLINE") + "\r\n3,,C");
+  ColumnCipher back(D, std::vector<unsigned int>{1}, ',', true, 1);
+  REQUIRE(back.transform(csv.transform("7,SECRET VALUE,KEPT\n")) == "7," + H.decrypt(H.encrypt("SECRET VALUE")) + ",KEPT\n");
+
+  ColumnCipher tsv(K, std::vector<unsigned int>{0}, '\t', false, 1);
+  REQUIRE(tsv.transform("\"AB\tC\n") == H.encrypt("\"AB") + "\tC\n");
+
+  //ciphertext can contain any alphabet character, so those cannot separate fields
+  const char alphabetic[] = { ' ', '.', '?', 'x', 'Q' };
+  for (unsigned int i = 0; i < 5; ++i)
+  {
+    ColumnCipher spaced(K, std::vector<unsigned int>{1}, alphabetic[i], true, 1);
+    REQUIRE(spaced.transform("x CE\n") == "");
+    REQUIRE(!spaced.run(0, 1));
+  }
+  ColumnCipher quoted(K, std::vector<unsigned int>{1}, '"', true, 1);
+  REQUIRE(quoted.transform("a\"b\n") == "");
+  //an index past MAX_COLUMNS would need a huge field table
+  ColumnCipher far(K, std::vector<unsigned int>{1, 4294967295u}, ',', true, 1);
+  REQUIRE(far.transform("a,b\n") == "");
+  REQUIRE(!far.run(0, 1));
+
+  //incomplete last record is held back unless the input ends
+  std::string part;
+  REQUIRE(csv.transform("1,AB,C\n2,DE", 12, false, part) == 7);
+  REQUIRE(part == "1," + H.encrypt("AB") + ",C\n");
+
+  //many pieces on several threads, with quoted newlines and delimiters crossing piece boundaries
+  std::string text, expected;
+  for (unsigned int r = 0; r < 200000; ++r)
+  {
+    std::string name = std::string(1 + r % 23, "NAMES?. "[r % 8]);
+    std::string note = (r % 5 == 0) ? "LINE ONE\nLINE, TWO" : "NOTE " + std::string(r % 7, 'Q');
+    std::string quoted = (r % 5 == 0) ? "\"" + note + "\"" : note;
+    text += std::to_string(r) + "," + name + "," + quoted + "\n";
+    expected += std::to_string(r) + "," + H.encrypt(name) + "," + H.encrypt(note) + "\n";
+  }
+  ColumnCipher wide(K, std::vector<unsigned int>{1, 2}, ',', true, 4);
+  REQUIRE(wide.transform(text) == expected);
+
+  //streamed through descriptors with a buffer smaller than some records
+  {
+    std::ofstream f("hill_columns.csv", std::ios::binary);
+    f << text;
+  }
+  int in = ::open("hill_columns.csv", O_RDONLY);
+  int out = ::open("hill_columns.out", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  REQUIRE(in >= 0);
+  REQUIRE(out >= 0);
+  REQUIRE(wide.run(in, out, 16));
+  ::close(in);
+  ::close(out);
+  REQUIRE(wide.consumed() == text.size());
+  std::ifstream c("hill_columns.out", std::ios::binary);
+  std::string C((std::istreambuf_iterator<char>(c)), std::istreambuf_iterator<char>());
+  REQUIRE(C == expected);
+  std::remove("hill_columns.csv");
+  std::remove("hill_columns.out");
+}
+
+TEST_CASE( "known-plaintext attack", "[Hill]" )
+{
+  INFO("Hint: kpa must pick n independent plaintext blocks mod 29, solve E and check it against every pair");
+  for (unsigned int n = 2; n <= 16; ++n)
+  {
+    Matrix key = KeyFile::random(n, 1000 + n);
+    Hill H(key, true);
+    REQUIRE(H.getE().equal(key));
+
+    //several pairs of uneven length; the first ones are too repetitive to reach rank n on their own
+    std::vector<std::string> P, C;
+    P.push_back(std::string(3 * n, 'A'));
+    P.push_back(std::string(n, 'B') + std::string(n, 'B'));
+    std::string text;
+    unsigned int x = n;
+    for (unsigned int i = 0; i < 8 * n * n + 5; ++i)
+    {
+      x = x * 1103515245 + 12345;
+      text += "ABCDEFGHIJKLMNOPQRSTUVWXYZ.? "[(x >> 16) % 29];
+    }
+    P.push_back(text);
+    P.push_back("known plaintext?");
+    for (size_t i = 0; i < P.size(); ++i)
+      C.push_back(H.encrypt(P[i]));
+
+    Hill attacker;
+    REQUIRE(attacker.kpa(P, C, n));
+    REQUIRE(attacker.getE().equal(key));
+    REQUIRE(attacker.getD().equal(H.getD()));
+    REQUIRE(attacker.decrypt(C[3]).compare(0, 16, "KNOWN PLAINTEXT?") == 0);
+
+    //rank below n: the keys stay as they were
+    Hill weak;
+    std::vector<std::string> P1(P.begin(), P.begin() + 2), C1(C.begin(), C.begin() + 2);
+    REQUIRE(!weak.kpa(P1, C1, n));
+    REQUIRE(weak.getE().equal(Hill().getE()));
+
+    //a pair that the solved key does not explain
+    std::vector<std::string> bad(C);
+    bad[3][0] = (bad[3][0] == 'A') ? 'B' : 'A';
+    REQUIRE(!weak.kpa(P, bad, n));
+  }
+
+  //a multi-megabyte pair set
+  Matrix key = KeyFile::random(16, 7);
+  Hill H(key, true);
+  std::string big;
+  unsigned int x = 1;
+  for (unsigned int i = 0; i < (4 << 20); ++i)
+  {
+    x = x * 1103515245 + 12345;
+    big += "ABCDEFGHIJKLMNOPQRSTUVWXYZ.? "[(x >> 16) % 29];
+  }
+  Hill attacker;
+  REQUIRE(attacker.kpa(std::vector<std::string>{big}, std::vector<std::string>{H.encrypt(big)}, 16));
+  REQUIRE(attacker.getE().equal(key));
+  REQUIRE(!attacker.kpa(std::vector<std::string>{big}, std::vector<std::string>{H.encrypt(big)}, 1));
+}
+
+TEST_CASE( "file transform refuses its own input", "[Hill]" )
+{
+  INFO("Hint: an output path naming the input file (or a hard link to it) would truncate the mapped input");
+  Hill H;
+  {
+    std::ofstream f("hill_self.txt", std::ios::binary);
+    f << "HELLO WORLD";
+  }
+  REQUIRE(::link("hill_self.txt", "hill_self_link.txt") == 0);
+  REQUIRE(!H.encryptFile("hill_self.txt", "hill_self.txt"));
+  REQUIRE(!H.encryptFile("hill_self.txt", "hill_self_link.txt"));
+  REQUIRE(!H.encryptFileParallel("hill_self.txt", "./hill_self.txt", 2));
+  std::ifstream f("hill_self.txt", std::ios::binary);
+  std::string P((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  REQUIRE(P == "HELLO WORLD");
+  std::remove("hill_self_link.txt");
+  std::remove("hill_self.txt");
+}
+
+TEST_CASE( "encrypt and decrypt with a given key", "[Hill]" )
+{
+  INFO("Hint: the key-taking overloads use the given key's size and validity, not the stored key's");
+  std::string P = "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG?";
+  Hill H;
+  Matrix E3 = KeyFile::random(3, 7);
+  Hill H3(E3, true);
+  REQUIRE(H.encrypt(P, E3) == H3.encrypt(P));
+  REQUIRE(H.decrypt(H3.encrypt(P), H3.getD()) == H3.decrypt(H3.encrypt(P)));
+
+  //determinant 29: non-zero over the integers, but not invertible mod 29
+  std::vector<int> det29 = {1, 2, 3, 35};
+  REQUIRE(H.encrypt(P, Matrix(det29, 2, 2)) == "");
+  REQUIRE(H.decrypt(P, Matrix(det29, 2, 2)) == "");
+}